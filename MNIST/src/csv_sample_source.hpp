@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "csv_reader.hpp"
+#include "../mlp/include/mlp.h"
+
+// Streams MNIST-format CSV shards (label followed by the pixels on each row)
+// one row at a time, so the training set never has to fit in memory.
+class CsvSampleSource : public SampleSource
+{
+public:
+    // skipRows leading rows of the first shard are skipped on every pass,
+    // e.g. because they are held out for validation.
+    CsvSampleSource(const std::vector<std::string> &shardPaths, size_t skipRows = 0,
+                    int sampleSize = 784, int numClasses = 10)
+        : m_shardPaths(shardPaths), m_skipRows(skipRows),
+          m_sampleSize(sampleSize), m_numClasses(numClasses), m_shard(0)
+    {
+        if (m_shardPaths.empty())
+        {
+            throw std::invalid_argument("No CSV shards given.");
+        }
+        rewind();
+    }
+
+    int sampleSize() const override { return m_sampleSize; }
+    int numClasses() const override { return m_numClasses; }
+
+    size_t read(unsigned char *pixels, unsigned char *labels, size_t maxCount) override
+    {
+        size_t count = 0;
+        while (count < maxCount && m_reader)
+        {
+            std::string line = m_reader->readNextRow();
+            if (line.empty() || line == "\r")
+            {
+                if (m_reader->eof())
+                {
+                    nextShard();
+                }
+                continue;
+            }
+            std::vector<std::string> row = CsvReader::splitString(line);
+            if (static_cast<int>(row.size()) != m_sampleSize + 1)
+            {
+                throw std::runtime_error("Invalid row format in CSV file: " + m_shardPaths[m_shard]);
+            }
+            labels[count] = static_cast<unsigned char>(std::stoi(row[0]));
+            for (int i = 0; i < m_sampleSize; ++i)
+            {
+                pixels[count * m_sampleSize + i] = static_cast<unsigned char>(std::stoi(row[i + 1]));
+            }
+            count++;
+        }
+        return count;
+    }
+
+    void rewind() override
+    {
+        m_shard = 0;
+        m_reader = std::make_unique<CsvReader>(m_shardPaths[0]);
+        for (size_t i = 0; i < m_skipRows && !m_reader->eof(); ++i)
+        {
+            m_reader->readNextRow();
+        }
+    }
+
+private:
+    std::vector<std::string> m_shardPaths;
+    size_t m_skipRows;
+    int m_sampleSize;
+    int m_numClasses;
+    size_t m_shard;
+    std::unique_ptr<CsvReader> m_reader;
+
+    void nextShard()
+    {
+        m_reader.reset();
+        if (++m_shard < m_shardPaths.size())
+        {
+            m_reader = std::make_unique<CsvReader>(m_shardPaths[m_shard]);
+        }
+    }
+};
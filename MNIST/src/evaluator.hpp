@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mlp/include/mlp.h"
+#include "../mlp/include/quantized_mlp.h"
+#include "../mlp/include/sparse_mlp.h"
+
+// Results of an evaluation run. confusion[expected][predicted] counts samples.
+struct EvaluationResult
+{
+    static const int NUM_CLASSES = 10;
+
+    int totalSamples = 0;
+    int correctPredictions = 0;
+    int confusion[NUM_CLASSES][NUM_CLASSES] = {};
+    double seconds = 0.0;
+
+    double accuracy() const
+    {
+        return totalSamples > 0 ? static_cast<double>(correctPredictions) / totalSamples : 0.0;
+    }
+
+    int classTotal(int digit) const
+    {
+        int total = 0;
+        for (int predicted = 0; predicted < NUM_CLASSES; ++predicted)
+        {
+            total += confusion[digit][predicted];
+        }
+        return total;
+    }
+
+    int classCorrect(int digit) const { return confusion[digit][digit]; }
+};
+
+// Evaluates a model on an MNIST CSV file. The calling thread reads the file
+// in large blocks and hands chunks of whole rows to a pool of workers; each
+// worker parses its chunk, runs inference on it as one batch and folds its
+// counts into shared atomic counters, so no lock guards the results.
+// A double-precision MLP, its int8 QuantizedMLP or a pruned SparseMLP is
+// evaluated.
+class StreamingEvaluator
+{
+public:
+    StreamingEvaluator(const MLP &mlp, int workers = 0, size_t chunkRows = 512)
+        : m_mlp(&mlp), m_workers(workers > 0 ? workers : defaultWorkers()), m_chunkRows(chunkRows)
+    {
+        checkOutputs(mlp.outputSize());
+    }
+
+    StreamingEvaluator(const QuantizedMLP &quantized, int workers = 0, size_t chunkRows = 512)
+        : m_quantized(&quantized), m_workers(workers > 0 ? workers : defaultWorkers()), m_chunkRows(chunkRows)
+    {
+        checkOutputs(quantized.outputSize());
+    }
+
+    StreamingEvaluator(const SparseMLP &sparse, int workers = 0, size_t chunkRows = 512)
+        : m_sparse(&sparse), m_workers(workers > 0 ? workers : defaultWorkers()), m_chunkRows(chunkRows)
+    {
+        checkOutputs(sparse.outputSize());
+    }
+
+    EvaluationResult evaluate(const std::string &csvPath)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        std::ifstream file(csvPath, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open the CSV file: " + csvPath);
+        }
+
+        for (auto &row : m_confusion)
+        {
+            for (auto &count : row)
+            {
+                count.store(0, std::memory_order_relaxed);
+            }
+        }
+        m_done = false;
+        m_error = nullptr;
+
+        std::vector<std::thread> pool;
+        for (int i = 0; i < m_workers; ++i)
+        {
+            pool.emplace_back([this]
+                              { workerLoop(); });
+        }
+
+        try
+        {
+            readChunks(file);
+        }
+        catch (...)
+        {
+            setError(std::current_exception());
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+        }
+        m_chunkAvailable.notify_all();
+        for (std::thread &worker : pool)
+        {
+            worker.join();
+        }
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+
+        EvaluationResult result;
+        for (int expected = 0; expected < EvaluationResult::NUM_CLASSES; ++expected)
+        {
+            for (int predicted = 0; predicted < EvaluationResult::NUM_CLASSES; ++predicted)
+            {
+                int count = m_confusion[expected][predicted].load(std::memory_order_relaxed);
+                result.confusion[expected][predicted] = count;
+                result.totalSamples += count;
+                if (expected == predicted)
+                {
+                    result.correctPredictions += count;
+                }
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+private:
+    static const size_t READ_BLOCK = 1 << 20;
+    static const size_t MAX_QUEUED_CHUNKS = 16;
+
+    const MLP *m_mlp = nullptr;
+    const QuantizedMLP *m_quantized = nullptr;
+    const SparseMLP *m_sparse = nullptr;
+    int m_workers;
+    size_t m_chunkRows;
+
+    std::mutex m_mutex;
+    std::condition_variable m_chunkAvailable;
+    std::condition_variable m_spaceAvailable;
+    std::deque<std::string> m_queue;
+    bool m_done = false;
+    std::exception_ptr m_error;
+
+    std::atomic<int> m_confusion[EvaluationResult::NUM_CLASSES][EvaluationResult::NUM_CLASSES];
+
+    static void checkOutputs(int outputSize)
+    {
+        if (outputSize != EvaluationResult::NUM_CLASSES)
+        {
+            throw std::invalid_argument("Evaluator expects a network with 10 outputs.");
+        }
+    }
+
+    static int defaultWorkers()
+    {
+        unsigned int n = std::thread::hardware_concurrency();
+        return n > 0 ? static_cast<int>(n) : 1;
+    }
+
+    void setError(std::exception_ptr error)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error)
+        {
+            m_error = error;
+        }
+        m_spaceAvailable.notify_all();
+    }
+
+    // Split the file into chunks of roughly m_chunkRows whole lines.
+    void readChunks(std::ifstream &file)
+    {
+        std::string pending;
+        std::vector<char> block(READ_BLOCK);
+        while (file)
+        {
+            file.read(block.data(), block.size());
+            pending.append(block.data(), static_cast<size_t>(file.gcount()));
+
+            size_t cut = 0;
+            size_t lines = 0;
+            for (size_t i = 0; i < pending.size(); ++i)
+            {
+                if (pending[i] == '\n' && ++lines == m_chunkRows)
+                {
+                    push(pending.substr(cut, i + 1 - cut));
+                    cut = i + 1;
+                    lines = 0;
+                }
+            }
+            pending.erase(0, cut);
+        }
+        if (!pending.empty())
+        {
+            push(std::move(pending));
+        }
+    }
+
+    void push(std::string chunk)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_spaceAvailable.wait(lock, [this]
+                              { return m_queue.size() < MAX_QUEUED_CHUNKS || m_error; });
+        if (m_error)
+        {
+            throw std::runtime_error("Evaluation aborted.");
+        }
+        m_queue.push_back(std::move(chunk));
+        m_chunkAvailable.notify_one();
+    }
+
+    void workerLoop()
+    {
+        const int inputSize = m_mlp      ? m_mlp->inputSize()
+                              : m_sparse ? m_sparse->inputSize()
+                                         : m_quantized->inputSize();
+        std::vector<unsigned char> pixels;
+        std::vector<int> labels;
+        std::vector<double> inputs;
+        std::vector<int> predictions;
+        InferenceContext context;
+        int localConfusion[EvaluationResult::NUM_CLASSES][EvaluationResult::NUM_CLASSES];
+
+        while (true)
+        {
+            std::string chunk;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_chunkAvailable.wait(lock, [this]
+                                      { return !m_queue.empty() || m_done || m_error; });
+                if (m_queue.empty() || m_error)
+                {
+                    return;
+                }
+                chunk = std::move(m_queue.front());
+                m_queue.pop_front();
+                m_spaceAvailable.notify_one();
+            }
+
+            try
+            {
+                size_t rows = parseChunk(chunk, inputSize, pixels, labels);
+
+                // Inference is const, so all workers share one model; each has its own scratch context.
+                predictions.resize(rows);
+                if (m_quantized)
+                {
+                    m_quantized->forwardBatch(pixels.data(), rows, predictions.data());
+                }
+                else
+                {
+                    inputs.resize(rows * inputSize);
+                    Dataset::normalize(pixels.data(), rows * inputSize, inputs.data());
+                    if (m_sparse)
+                    {
+                        m_sparse->forwardBatch(inputs.data(), rows, predictions.data());
+                    }
+                    else
+                    {
+                        m_mlp->forwardBatch(inputs.data(), rows, predictions.data(), context);
+                    }
+                }
+
+                std::fill(&localConfusion[0][0], &localConfusion[0][0] + sizeof(localConfusion) / sizeof(int), 0);
+                for (size_t row = 0; row < rows; ++row)
+                {
+                    localConfusion[labels[row]][predictions[row]]++;
+                }
+                for (int expected = 0; expected < EvaluationResult::NUM_CLASSES; ++expected)
+                {
+                    for (int predicted = 0; predicted < EvaluationResult::NUM_CLASSES; ++predicted)
+                    {
+                        if (localConfusion[expected][predicted])
+                        {
+                            m_confusion[expected][predicted].fetch_add(localConfusion[expected][predicted],
+                                                                       std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+            catch (...)
+            {
+                setError(std::current_exception());
+                m_chunkAvailable.notify_all();
+                return;
+            }
+        }
+    }
+
+    // Parse "label,p0,...,p783" rows without any per-field allocation.
+    static size_t parseChunk(const std::string &chunk, int inputSize,
+                             std::vector<unsigned char> &pixels, std::vector<int> &labels)
+    {
+        pixels.clear();
+        labels.clear();
+        const char *p = chunk.data();
+        const char *end = p + chunk.size();
+        while (p < end)
+        {
+            if (*p == '\n' || *p == '\r')
+            {
+                ++p;
+                continue;
+            }
+
+            int fields = 0;
+            while (p < end && *p != '\n' && *p != '\r')
+            {
+                if (*p < '0' || *p > '9')
+                {
+                    throw std::runtime_error("Invalid row format in CSV file.");
+                }
+                // Saturates above 255, so a long run of digits cannot overflow.
+                int value = 0;
+                while (p < end && *p >= '0' && *p <= '9')
+                {
+                    value = std::min(value * 10 + (*p++ - '0'), 256);
+                }
+                if (fields == 0)
+                {
+                    if (value >= EvaluationResult::NUM_CLASSES)
+                    {
+                        throw std::runtime_error("Label out of range in CSV file.");
+                    }
+                    labels.push_back(value);
+                }
+                else
+                {
+                    pixels.push_back(static_cast<unsigned char>(std::min(value, 255)));
+                }
+                ++fields;
+                if (p < end && *p == ',')
+                {
+                    ++p;
+                }
+            }
+            if (fields != inputSize + 1)
+            {
+                throw std::runtime_error("Invalid row format in CSV file.");
+            }
+        }
+        return labels.size();
+    }
+};
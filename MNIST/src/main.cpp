@@ -6,11 +6,20 @@
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
+#include <iomanip>
+#include <filesystem>
+#include <chrono>
 
 #include <opencv2/opencv.hpp>
 
 #include "csv_reader.hpp"
+#include "csv_sample_source.hpp"
+#include "evaluator.hpp"
 #include "../mlp/include/mlp.h"
+#include "../mlp/include/quantized_mlp.h"
+#include "../mlp/include/activation_calibrator.h"
+#include "../mlp/include/sparse_mlp.h"
+#include "../mlp/include/teacher_logits.h"
 
 //============================================================================
 // Parameters
@@ -21,8 +30,50 @@ const int TRAINING_SAMPLES = 60000;
 const int HIDDEN_NEURONS_LAYER1 = 128;
 const int HIDDEN_NEURONS_LAYER2 = 64;
 
+// Seeds the initial weights, the shuffle order and the augmentation, so a
+// run is reproducible
+const uint64_t SEED = 42;
+
+// On-the-fly augmentation (random shift, rotation, scale, elastic distortion)
+const bool USE_AUGMENTATION = true;
+const int LOADER_THREADS = 2;
+
+// Quantization-aware training for a model that will run on the int8 engine:
+// weight bits (0 = off; 8 matches QuantizedMLP) and activation bits
+const int QUANTIZE_WEIGHT_BITS = 0;
+const int QUANTIZE_ACTIVATION_BITS = 7;
+
+// Default model of the evaluation and calibration commands
+const std::string DEFAULT_MODEL = "models/model_0.01_100_60000_128_64";
+
+// Calibration: share of activations kept at each end by the percentile method
+const double CALIBRATION_PERCENTILE = 99.99;
+
+// Pruning: share of the weights removed and epochs of fine-tuning afterwards
+// on the training split (0 = none)
+const double PRUNING_SPARSITY = 0.9;
+const int PRUNING_FINE_TUNE_EPOCHS = 10;
+
+// Distillation: hidden layers of the student, softening temperature of the
+// teacher's outputs and their weight against the labels
+const std::vector<int> STUDENT_HIDDEN_NEURONS = {32};
+const double DISTILLATION_TEMPERATURE = 4.0;
+const double DISTILLATION_ALPHA = 0.9;
+
+// Streaming training: shards are read sequentially and never held in memory
+const std::vector<std::string> STREAMING_SHARDS = {"resources/training_data/mnist_train.csv"};
+const int STREAMING_VALIDATION_SAMPLES = 12000; // leading rows of the first shard
+const size_t SHUFFLE_WINDOW = 65536;
+
+// The best weights are written to <model path>.checkpoint during training and
+// the current ones with the training state to <model path>.checkpoint.last
+// every few epochs. An interrupted run resumes from the latter when started again.
+const int CHECKPOINT_INTERVAL = 5;
+
 // Input and output sizes for the MNIST dataset
-const int INPUT_SIZE = 784; // 28x28 pixels
+const int IMAGE_WIDTH = 28;
+const int IMAGE_HEIGHT = 28;
+const int INPUT_SIZE = IMAGE_WIDTH * IMAGE_HEIGHT; // 28x28 pixels
 const int OUTPUT_SIZE = 10; // Digits 0 to 9
 
 //============================================================================
@@ -35,21 +86,6 @@ int getPredictedClass(const std::vector<double> &output)
     return static_cast<int>(std::max_element(output.begin(), output.end()) - output.begin());
 }
 
-// One-hot encode an integer label (assumes classes 0 to 9)
-std::vector<double> oneHotEncode(int label, int numClasses = OUTPUT_SIZE)
-{
-    std::vector<double> encoded(numClasses, 0.0);
-    if (label >= 0 && label < numClasses)
-    {
-        encoded[label] = 1.0;
-    }
-    else
-    {
-        throw std::runtime_error("Label out of range for one-hot encoding.");
-    }
-    return encoded;
-}
-
 // Convert vector of char pixel values [0,255] to normalized double values [0,1]
 std::vector<double> normalizePixels(const std::vector<unsigned char> &pixels)
 {
@@ -62,6 +98,27 @@ std::vector<double> normalizePixels(const std::vector<unsigned char> &pixels)
     return normalized;
 }
 
+// Load the first `samples` rows of an MNIST CSV file as raw bytes
+Dataset loadDataset(const std::string &csvPath, int samples)
+{
+    CsvReader reader(csvPath);
+    Dataset data(INPUT_SIZE, OUTPUT_SIZE);
+    data.reserve(samples);
+    for (int i = 0; i < samples && !reader.eof(); ++i)
+    {
+        auto [label, pixels] = reader.getLabelAndPixels();
+        data.addSample(pixels.data(), label);
+    }
+    return data;
+}
+
+// The last 20% of the loaded training rows, held out for validation
+DatasetView validationSplit(const Dataset &data)
+{
+    size_t validationSize = data.size() / 5;
+    return DatasetView(data, data.size() - validationSize, validationSize);
+}
+
 // Build model file path based on parameters
 std::string buildModelPath()
 {
@@ -84,136 +141,170 @@ void train()
     std::string csvTrainingFile = "resources/training_data/mnist_train.csv";
     std::string csvTestingFile = "resources/training_data/mnist_test.csv";
 
-    CsvReader trainReader(csvTrainingFile);
-    std::vector<std::vector<double>> allInputs;
-    std::vector<std::vector<double>> allTargets;
+    // Load all training data as raw bytes; normalization happens per batch
+    Dataset allData = loadDataset(csvTrainingFile, TRAINING_SAMPLES);
 
-    // Load all training data
-    for (int i = 0; i < TRAINING_SAMPLES && !trainReader.eof(); ++i)
-    {
-        auto [label, pixels] = trainReader.getLabelAndPixels();
-        allInputs.push_back(normalizePixels(pixels));
-        allTargets.push_back(oneHotEncode(label));
-    }
-
-    // Split into training (80%) and validation (20%) sets
-    size_t totalSamples = allInputs.size();
-    size_t validationSize = totalSamples / 5; // 20% for validation
-    size_t trainingSize = totalSamples - validationSize;
-
-    std::vector<std::vector<double>> trainingInputs(allInputs.begin(), allInputs.begin() + trainingSize);
-    std::vector<std::vector<double>> trainingTargets(allTargets.begin(), allTargets.begin() + trainingSize);
-    std::vector<std::vector<double>> validationInputs(allInputs.begin() + trainingSize, allInputs.end());
-    std::vector<std::vector<double>> validationTargets(allTargets.begin() + trainingSize, allTargets.end());
+    // Split into training (80%) and validation (20%) sets. Views only
+    // record index ranges, the samples are not copied
+    DatasetView validationData = validationSplit(allData);
+    size_t validationSize = validationData.size();
+    size_t trainingSize = allData.size() - validationSize;
+    DatasetView trainingData(allData, 0, trainingSize);
 
     // two hidden layers
     std::vector<int> hiddenLayers = {HIDDEN_NEURONS_LAYER1, HIDDEN_NEURONS_LAYER2};
 
     // create mlp
-    MLP mlp(INPUT_SIZE, hiddenLayers, OUTPUT_SIZE, LEARNING_RATE);
+    MLP mlp(INPUT_SIZE, hiddenLayers, OUTPUT_SIZE, LEARNING_RATE, WeightInit::Xavier, SEED);
 
     std::cout << "Starting training with " << trainingSize << " training samples and "
               << validationSize << " validation samples." << std::endl;
 
-    mlp.startTraining(trainingInputs, trainingTargets, validationInputs, validationTargets, EPOCHS);
+    TrainingOptions options;
+    options.epochs = EPOCHS;
+    options.seed = SEED;
+    options.checkpointPath = buildModelPath() + ".checkpoint";
+    options.checkpointInterval = CHECKPOINT_INTERVAL;
+    options.quantizeWeightBits = QUANTIZE_WEIGHT_BITS;
+    options.quantizeActivationBits = QUANTIZE_ACTIVATION_BITS;
+    if (USE_AUGMENTATION)
+    {
+        // Augmented samples are produced by the loader threads, never stored
+        options.augment = ImageAugmenter(IMAGE_WIDTH, IMAGE_HEIGHT);
+        options.loaderThreads = LOADER_THREADS;
+    }
+
+    std::string resumePath = options.checkpointPath + ".last";
+    if (std::filesystem::exists(resumePath))
+    {
+        mlp.resumeTraining(resumePath, trainingData, validationData, options);
+    }
+    else
+    {
+        mlp.startTraining(trainingData, validationData, options);
+    }
     std::cout << "Training completed." << std::endl;
 
     std::string modelPath = buildModelPath();
     mlp.saveModel(modelPath);
+    std::filesystem::remove(resumePath);
     std::cout << "Model saved to: " << modelPath << std::endl;
 }
 
-//============================================================================
-// Evaluation Functionality
-//============================================================================
-
-void evaluateModel(std::string modelPath = buildModelPath())
+// Train on shards that may be larger than RAM. Memory use is bounded by the
+// shuffle window and the in-memory validation set, whatever the shard sizes.
+void trainStreaming()
 {
-    std::string csvTestingFile = "resources/training_data/mnist_test.csv";
-
-    // two hidden layers
-    std::vector<int> hiddenLayers = {HIDDEN_NEURONS_LAYER1, HIDDEN_NEURONS_LAYER2};
-
-    // Note: The learning rate here is not used in inference.
-    MLP mlp(INPUT_SIZE, hiddenLayers, OUTPUT_SIZE, 0.01);
-
-    mlp.loadModel(modelPath);
-    std::cout << "Model loaded successfully from file: " << modelPath << std::endl;
-
-    CsvReader testReader(csvTestingFile);
-
-    // Comprehensive evaluation on full test set
-    std::cout << "\n----- Evaluating on full test set -----" << std::endl;
-
-    int totalSamples = 0;
-    int correctPredictions = 0;
-    std::vector<int> classCorrect(10, 0); // Track correct predictions per digit
-    std::vector<int> classTotal(10, 0);   // Track total samples per digit
-
-    try
+    // Hold out the first rows of the first shard for validation
+    CsvReader validationReader(STREAMING_SHARDS.front());
+    Dataset validationData(INPUT_SIZE, OUTPUT_SIZE);
+    validationData.reserve(STREAMING_VALIDATION_SAMPLES);
+    for (int i = 0; i < STREAMING_VALIDATION_SAMPLES && !validationReader.eof(); ++i)
     {
-        while (!testReader.eof())
-        {
-            auto [testLabel, testPixels] = testReader.getLabelAndPixels();
-            std::vector<double> testInput = normalizePixels(testPixels);
-            auto output = mlp.forward(testInput);
-
-            int predictedClass = getPredictedClass(output);
+        auto [label, pixels] = validationReader.getLabelAndPixels();
+        validationData.addSample(pixels.data(), label);
+    }
 
-            totalSamples++;
-            classTotal[testLabel]++;
+    CsvSampleSource trainingSource(STREAMING_SHARDS, validationData.size());
 
-            if (predictedClass == testLabel)
-            {
-                correctPredictions++;
-                classCorrect[testLabel]++;
-            }
+    std::vector<int> hiddenLayers = {HIDDEN_NEURONS_LAYER1, HIDDEN_NEURONS_LAYER2};
+    MLP mlp(INPUT_SIZE, hiddenLayers, OUTPUT_SIZE, LEARNING_RATE, WeightInit::Xavier, SEED);
+
+    TrainingOptions options;
+    options.epochs = EPOCHS;
+    options.seed = SEED;
+    options.checkpointPath = buildModelPath() + ".checkpoint";
+    options.checkpointInterval = CHECKPOINT_INTERVAL;
+    options.quantizeWeightBits = QUANTIZE_WEIGHT_BITS;
+    options.quantizeActivationBits = QUANTIZE_ACTIVATION_BITS;
+    options.shuffleWindow = SHUFFLE_WINDOW;
+    if (USE_AUGMENTATION)
+    {
+        options.augment = ImageAugmenter(IMAGE_WIDTH, IMAGE_HEIGHT);
+    }
 
-            // Show progress every 1000 samples
-            if (totalSamples % 1000 == 0)
-            {
-                std::cout << "Processed " << totalSamples << " samples..." << std::endl;
-            }
-        }
+    std::string resumePath = options.checkpointPath + ".last";
+    if (std::filesystem::exists(resumePath))
+    {
+        mlp.resumeStreamingTraining(resumePath, trainingSource, validationData, options);
     }
-    catch (const std::exception &e)
+    else
     {
-        std::cout << "Evaluation completed early due to: " << e.what() << std::endl;
-        std::cout << "Total samples processed: " << totalSamples << std::endl;
+        mlp.startStreamingTraining(trainingSource, validationData, options);
     }
+    std::cout << "Training completed." << std::endl;
 
-    // Calculate and display results
-    double accuracy = static_cast<double>(correctPredictions) / totalSamples * 100.0;
+    std::string modelPath = buildModelPath();
+    mlp.saveModel(modelPath);
+    std::filesystem::remove(resumePath);
+    std::cout << "Model saved to: " << modelPath << std::endl;
+}
 
+//============================================================================
+// Evaluation Functionality
+//============================================================================
+
+// Print overall accuracy, the per-digit breakdown and the confusion matrix
+void printEvaluation(const EvaluationResult &result)
+{
     std::cout << "\n==================== EVALUATION RESULTS ====================" << std::endl;
-    std::cout << "Total samples tested: " << totalSamples << std::endl;
-    std::cout << "Correct predictions: " << correctPredictions << std::endl;
-    std::cout << "Overall accuracy: " << accuracy << "%" << std::endl;
+    std::cout << "Total samples tested: " << result.totalSamples << std::endl;
+    std::cout << "Correct predictions: " << result.correctPredictions << std::endl;
+    std::cout << "Overall accuracy: " << result.accuracy() * 100.0 << "%" << std::endl;
+    std::cout << "Evaluation time: " << result.seconds << " s" << std::endl;
 
     std::cout << "\n----- Per-digit accuracy -----" << std::endl;
     for (int digit = 0; digit < 10; digit++)
     {
-        if (classTotal[digit] > 0)
+        int classTotal = result.classTotal(digit);
+        if (classTotal > 0)
         {
-            double digitAccuracy = static_cast<double>(classCorrect[digit]) / classTotal[digit] * 100.0;
+            double digitAccuracy = static_cast<double>(result.classCorrect(digit)) / classTotal * 100.0;
             std::cout << "Digit " << digit << ": " << digitAccuracy << "% ("
-                      << classCorrect[digit] << "/" << classTotal[digit] << ")" << std::endl;
+                      << result.classCorrect(digit) << "/" << classTotal << ")" << std::endl;
         }
     }
+
+    std::cout << "\n----- Confusion matrix (rows: expected, columns: predicted) -----" << std::endl;
+    std::cout << "     ";
+    for (int predicted = 0; predicted < 10; predicted++)
+    {
+        std::cout << std::setw(6) << predicted;
+    }
+    std::cout << std::endl;
+    for (int expected = 0; expected < 10; expected++)
+    {
+        std::cout << std::setw(5) << expected;
+        for (int predicted = 0; predicted < 10; predicted++)
+        {
+            std::cout << std::setw(6) << result.confusion[expected][predicted];
+        }
+        std::cout << std::endl;
+    }
     std::cout << "==========================================================" << std::endl;
 }
 
-void loadModel(std::string modelPath = buildModelPath())
+void evaluateModel(std::string modelPath = buildModelPath())
 {
     std::string csvTestingFile = "resources/training_data/mnist_test.csv";
 
-    // two hidden layers
-    std::vector<int> hiddenLayers = {HIDDEN_NEURONS_LAYER1, HIDDEN_NEURONS_LAYER2};
+    // The topology is read from the model file.
+    MLP mlp = MLP::fromFile(modelPath);
+    std::cout << "Model loaded successfully from file: " << modelPath << std::endl;
 
-    // Note: The learning rate here is not used in inference.
-    MLP mlp(INPUT_SIZE, hiddenLayers, OUTPUT_SIZE, 0.01);
+    // Comprehensive evaluation on full test set, decoded and scored in parallel
+    std::cout << "\n----- Evaluating on full test set -----" << std::endl;
+
+    StreamingEvaluator evaluator(mlp);
+    printEvaluation(evaluator.evaluate(csvTestingFile));
+}
+
+void loadModel(std::string modelPath = buildModelPath())
+{
+    std::string csvTestingFile = "resources/training_data/mnist_test.csv";
 
-    mlp.loadModel(modelPath);
+    // The topology is read from the model file.
+    MLP mlp = MLP::fromFile(modelPath);
     std::cout << "Model loaded successfully from file: " << modelPath
               << std::endl;
 
@@ -238,22 +329,475 @@ void loadModel(std::string modelPath = buildModelPath())
     }
 }
 
+//============================================================================
+// Quantization Functionality
+//============================================================================
+
+// Post-training quantization: calibrate the activation ranges of a model on
+// the validation split train() holds out, write an int8 model with the
+// ranges, and compare both models on the test set.
+void calibrateModel(const std::string &modelPath, const std::string &outputPath,
+                    CalibrationMethod method, double percentile)
+{
+    std::string csvTrainingFile = "resources/training_data/mnist_train.csv";
+    std::string csvTestingFile = "resources/training_data/mnist_test.csv";
+
+    MLP mlp = MLP::fromFile(modelPath);
+    std::cout << "Model loaded successfully from file: " << modelPath << std::endl;
+
+    Dataset allData = loadDataset(csvTrainingFile, TRAINING_SAMPLES);
+    ActivationCalibrator calibrator(mlp);
+    calibrator.observe(validationSplit(allData));
+
+    std::vector<ActivationRange> observed = calibrator.observedRanges();
+    std::vector<ActivationRange> ranges = calibrator.ranges(method, percentile);
+    std::cout << "\n----- Activation ranges from " << calibrator.samples() << " validation samples -----" << std::endl;
+    for (size_t layer = 0; layer < ranges.size(); layer++)
+    {
+        std::cout << "Layer " << layer + 1 << " inputs: observed [" << observed[layer].low << ", "
+                  << observed[layer].high << "], quantized over [" << ranges[layer].low << ", "
+                  << ranges[layer].high << "]" << std::endl;
+    }
+
+    QuantizedMLP::saveCalibrated(mlp, ranges, outputPath);
+    std::cout << "Quantized model saved to: " << outputPath << std::endl;
+
+    std::cout << "\n----- Before quantization (float64) -----" << std::endl;
+    EvaluationResult before = StreamingEvaluator(mlp).evaluate(csvTestingFile);
+    printEvaluation(before);
+
+    QuantizedMLP quantized = QuantizedMLP::fromFile(outputPath);
+    std::cout << "\n----- After quantization (int8, " << QuantizedMLP::kernelName() << " kernel) -----" << std::endl;
+    EvaluationResult after = StreamingEvaluator(quantized).evaluate(csvTestingFile);
+    printEvaluation(after);
+
+    std::cout << "\n----- Per-digit accuracy before -> after -----" << std::endl;
+    for (int digit = 0; digit < 10; digit++)
+    {
+        if (before.classTotal(digit) > 0)
+        {
+            std::cout << "Digit " << digit << ": "
+                      << static_cast<double>(before.classCorrect(digit)) / before.classTotal(digit) * 100.0 << "% -> "
+                      << static_cast<double>(after.classCorrect(digit)) / after.classTotal(digit) * 100.0 << "%" << std::endl;
+        }
+    }
+    std::cout << "Overall: " << before.accuracy() * 100.0 << "% -> " << after.accuracy() * 100.0 << "% ("
+              << std::showpos << (after.accuracy() - before.accuracy()) * 100.0 << std::noshowpos
+              << " percentage points)" << std::endl;
+}
+
+//============================================================================
+// Pruning Functionality
+//============================================================================
+
+// Seconds for one batched inference pass over the whole test set.
+template <typename Model>
+double timeInference(const Model &model, const std::vector<double> &inputs, size_t count)
+{
+    std::vector<int> classes(count);
+    auto start = std::chrono::steady_clock::now();
+    model.forwardBatch(inputs.data(), count, classes.data());
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Magnitude pruning: remove the smallest weights of a model, optionally
+// fine-tune the remaining ones on the split train() uses, and compare the
+// original, the pruned network and its sparse inference engine on the test set.
+void pruneModel(const std::string &modelPath, const std::string &outputPath, double sparsity,
+                PruningScope scope, int fineTuneEpochs)
+{
+    std::string csvTrainingFile = "resources/training_data/mnist_train.csv";
+    std::string csvTestingFile = "resources/training_data/mnist_test.csv";
+
+    // Copied rather than mapped, as the weights are modified.
+    MLP mlp = MLP::fromFile(modelPath, false);
+    std::cout << "Model loaded successfully from file: " << modelPath << std::endl;
+
+    Dataset testData = loadDataset(csvTestingFile, 10000);
+    std::vector<double> testInputs(testData.size() * INPUT_SIZE);
+    testData.gatherRange(0, testData.size(), testInputs.data(), nullptr);
+
+    size_t weights = 0;
+    size_t biases = 0;
+    for (int l = 0; l < mlp.numLayers(); l++)
+    {
+        LayerParameters layer = mlp.layer(l);
+        weights += static_cast<size_t>(layer.inputs) * layer.outputs;
+        biases += layer.outputs;
+    }
+    size_t denseBytes = (weights + biases) * sizeof(double);
+    double denseSeconds = timeInference(mlp, testInputs, testData.size());
+    EvaluationResult before = StreamingEvaluator(mlp).evaluate(csvTestingFile);
+
+    size_t pruned = mlp.prune(sparsity, scope);
+    std::cout << "\nPruned " << pruned << " weights (" << sparsity * 100.0 << "%, "
+              << (scope == PruningScope::Global ? "global" : "per-layer") << " ranking)" << std::endl;
+    std::cout << "Test accuracy without fine-tuning: "
+              << StreamingEvaluator(mlp).evaluate(csvTestingFile).accuracy() * 100.0 << "%" << std::endl;
+
+    if (fineTuneEpochs > 0)
+    {
+        Dataset allData = loadDataset(csvTrainingFile, TRAINING_SAMPLES);
+        DatasetView validationData = validationSplit(allData);
+        DatasetView trainingData(allData, 0, allData.size() - validationData.size());
+
+        // Pruned weights stay zero while the others are trained.
+        TrainingOptions options;
+        options.epochs = fineTuneEpochs;
+        options.seed = SEED;
+        mlp.startTraining(trainingData, validationData, options);
+    }
+
+    mlp.saveModel(outputPath);
+    std::cout << "Pruned model saved to: " << outputPath << std::endl;
+
+    SparseMLP sparse(mlp);
+    std::cout << "\n----- Pruned model (sparse, " << SparseMLP::kernelName() << " kernel) -----" << std::endl;
+    EvaluationResult after = StreamingEvaluator(sparse).evaluate(csvTestingFile);
+    printEvaluation(after);
+
+    double sparseSeconds = timeInference(sparse, testInputs, testData.size());
+    std::cout << "\n----- Original -> pruned -----" << std::endl;
+    std::cout << "Accuracy: " << before.accuracy() * 100.0 << "% -> " << after.accuracy() * 100.0 << "% ("
+              << std::showpos << (after.accuracy() - before.accuracy()) * 100.0 << std::noshowpos
+              << " percentage points)" << std::endl;
+    std::cout << "Weights: " << weights << " -> " << sparse.nonZeros() << " (" << sparse.density() * 100.0 << "%)"
+              << std::endl;
+    std::cout << "Parameter memory: " << denseBytes / 1024 << " KiB -> " << sparse.parameterBytes() / 1024
+              << " KiB" << std::endl;
+    std::cout << "Inference on " << testData.size() << " samples: " << denseSeconds * 1000.0 << " ms -> "
+              << sparseSeconds * 1000.0 << " ms (" << denseSeconds / sparseSeconds << "x)" << std::endl;
+}
+
+//============================================================================
+// Distillation Functionality
+//============================================================================
+
+// Multiply-adds of one forward pass.
+size_t multiplyAdds(const MLP &mlp)
+{
+    size_t total = 0;
+    for (int l = 0; l < mlp.numLayers(); l++)
+    {
+        total += static_cast<size_t>(mlp.layer(l).inputs) * mlp.layer(l).outputs;
+    }
+    return total;
+}
+
+// Knowledge distillation: train a small student network on the split train()
+// uses, against the softened outputs of a trained teacher and the labels,
+// and compare both on the test set. The teacher runs once, over all training
+// samples, before the first epoch. Augmentation is off, as the cached
+// outputs are those of the original samples.
+void distillModel(const std::string &teacherPath, const std::string &outputPath,
+                  const std::vector<int> &hiddenLayers, double temperature, double alpha, int epochs)
+{
+    std::string csvTrainingFile = "resources/training_data/mnist_train.csv";
+    std::string csvTestingFile = "resources/training_data/mnist_test.csv";
+
+    MLP teacher = MLP::fromFile(teacherPath);
+    std::cout << "Teacher loaded successfully from file: " << teacherPath << std::endl;
+
+    Dataset allData = loadDataset(csvTrainingFile, TRAINING_SAMPLES);
+    DatasetView validationData = validationSplit(allData);
+    DatasetView trainingData(allData, 0, allData.size() - validationData.size());
+
+    auto cacheStart = std::chrono::steady_clock::now();
+    TeacherLogits teacherLogits(teacher, allData);
+    std::cout << "Cached teacher logits of " << teacherLogits.size() << " samples in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - cacheStart).count() << " s"
+              << std::endl;
+
+    MLP student(INPUT_SIZE, hiddenLayers, OUTPUT_SIZE, LEARNING_RATE, WeightInit::Xavier, SEED);
+    TrainingOptions options;
+    options.epochs = epochs;
+    options.seed = SEED;
+    options.teacher = &teacherLogits;
+    options.distillationTemperature = temperature;
+    options.distillationAlpha = alpha;
+    student.startTraining(trainingData, validationData, options);
+
+    student.saveModel(outputPath);
+    std::cout << "Student saved to: " << outputPath << std::endl;
+
+    std::cout << "\n----- Student -----" << std::endl;
+    EvaluationResult studentResult = StreamingEvaluator(student).evaluate(csvTestingFile);
+    printEvaluation(studentResult);
+    EvaluationResult teacherResult = StreamingEvaluator(teacher).evaluate(csvTestingFile);
+
+    Dataset testData = loadDataset(csvTestingFile, 10000);
+    std::vector<double> testInputs(testData.size() * INPUT_SIZE);
+    testData.gatherRange(0, testData.size(), testInputs.data(), nullptr);
+    double teacherSeconds = timeInference(teacher, testInputs, testData.size());
+    double studentSeconds = timeInference(student, testInputs, testData.size());
+
+    std::cout << "\n----- Teacher -> student -----" << std::endl;
+    std::cout << "Accuracy: " << teacherResult.accuracy() * 100.0 << "% -> " << studentResult.accuracy() * 100.0
+              << "% (" << std::showpos << (studentResult.accuracy() - teacherResult.accuracy()) * 100.0
+              << std::noshowpos << " percentage points)" << std::endl;
+    std::cout << "Multiply-adds per sample: " << multiplyAdds(teacher) << " -> " << multiplyAdds(student)
+              << std::endl;
+    std::cout << "Inference on " << testData.size() << " samples: " << teacherSeconds * 1000.0 << " ms -> "
+              << studentSeconds * 1000.0 << " ms (" << teacherSeconds / studentSeconds << "x)" << std::endl;
+}
+
+//============================================================================
+// Command Line
+//============================================================================
+
+void printUsage()
+{
+    std::cout << "Usage: MNIST                      quick test and evaluation of the default model\n"
+              << "       MNIST calibrate [model] [options]\n"
+              << "       MNIST prune [model] [options]\n"
+              << "       MNIST distill [teacher] [options]\n"
+              << "\n"
+              << "calibrate writes an int8 model calibrated on the validation split and\n"
+              << "compares its per-digit test accuracy with the original.\n"
+              << "\n"
+              << "Options:\n"
+              << "  --output <path>      quantized model (default: <model>.int8)\n"
+              << "  --method <name>      minmax, percentile (default) or entropy\n"
+              << "  --percentile <p>     share kept at each end in percent (default: " << CALIBRATION_PERCENTILE << ")\n"
+              << "\n"
+              << "prune zeroes the smallest weights, fine-tunes the rest and compares the\n"
+              << "sparse model's test accuracy, memory and speed with the original.\n"
+              << "\n"
+              << "Options:\n"
+              << "  --output <path>      pruned model (default: <model>.pruned)\n"
+              << "  --sparsity <s>       share of weights removed, 0 to 1 (default: " << PRUNING_SPARSITY << ")\n"
+              << "  --scope <name>       global (default) or layer\n"
+              << "  --epochs <n>         fine-tuning epochs, 0 for none (default: " << PRUNING_FINE_TUNE_EPOCHS << ")\n"
+              << "\n"
+              << "distill trains a small student network against the teacher's outputs\n"
+              << "and the labels, and compares its test accuracy and speed with the teacher.\n"
+              << "\n"
+              << "Options:\n"
+              << "  --output <path>      student model (default: models/student_<hidden sizes>)\n"
+              << "  --hidden <sizes>     student hidden layers, comma-separated (default: 32)\n"
+              << "  --temperature <t>    softening of the teacher's outputs (default: " << DISTILLATION_TEMPERATURE << ")\n"
+              << "  --alpha <a>          weight of the teacher against the labels (default: " << DISTILLATION_ALPHA << ")\n"
+              << "  --epochs <n>         maximum training epochs (default: " << EPOCHS << ")"
+              << std::endl;
+}
+
+CalibrationMethod parseCalibrationMethod(const std::string &name)
+{
+    if (name == "minmax")
+    {
+        return CalibrationMethod::MinMax;
+    }
+    if (name == "percentile")
+    {
+        return CalibrationMethod::Percentile;
+    }
+    if (name == "entropy")
+    {
+        return CalibrationMethod::Entropy;
+    }
+    throw std::invalid_argument("Unknown calibration method: " + name);
+}
+
+PruningScope parsePruningScope(const std::string &name)
+{
+    if (name == "global")
+    {
+        return PruningScope::Global;
+    }
+    if (name == "layer")
+    {
+        return PruningScope::PerLayer;
+    }
+    throw std::invalid_argument("Unknown pruning scope: " + name);
+}
+
+// Layer sizes such as "64,32".
+std::vector<int> parseHiddenSizes(const std::string &text)
+{
+    std::vector<int> sizes;
+    std::stringstream stream(text);
+    std::string size;
+    while (std::getline(stream, size, ','))
+    {
+        sizes.push_back(std::stoi(size));
+        if (sizes.back() <= 0)
+        {
+            throw std::invalid_argument("Invalid hidden layer sizes: " + text);
+        }
+    }
+    if (sizes.empty())
+    {
+        throw std::invalid_argument("Invalid hidden layer sizes: " + text);
+    }
+    return sizes;
+}
+
+int runCalibrate(int argc, char **argv)
+{
+    std::string modelPath = DEFAULT_MODEL;
+    std::string outputPath;
+    CalibrationMethod method = CalibrationMethod::Percentile;
+    double percentile = CALIBRATION_PERCENTILE;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (arg == "--method" && i + 1 < argc)
+        {
+            method = parseCalibrationMethod(argv[++i]);
+        }
+        else if (arg == "--percentile" && i + 1 < argc)
+        {
+            percentile = std::stod(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            modelPath = arg;
+        }
+    }
+    calibrateModel(modelPath, outputPath.empty() ? modelPath + ".int8" : outputPath, method, percentile);
+    return 0;
+}
+
+int runPrune(int argc, char **argv)
+{
+    std::string modelPath = DEFAULT_MODEL;
+    std::string outputPath;
+    double sparsity = PRUNING_SPARSITY;
+    PruningScope scope = PruningScope::Global;
+    int epochs = PRUNING_FINE_TUNE_EPOCHS;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (arg == "--sparsity" && i + 1 < argc)
+        {
+            sparsity = std::stod(argv[++i]);
+        }
+        else if (arg == "--scope" && i + 1 < argc)
+        {
+            scope = parsePruningScope(argv[++i]);
+        }
+        else if (arg == "--epochs" && i + 1 < argc)
+        {
+            epochs = std::stoi(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            modelPath = arg;
+        }
+    }
+    pruneModel(modelPath, outputPath.empty() ? modelPath + ".pruned" : outputPath, sparsity, scope, epochs);
+    return 0;
+}
+
+int runDistill(int argc, char **argv)
+{
+    std::string teacherPath = DEFAULT_MODEL;
+    std::string outputPath;
+    std::vector<int> hiddenLayers = STUDENT_HIDDEN_NEURONS;
+    double temperature = DISTILLATION_TEMPERATURE;
+    double alpha = DISTILLATION_ALPHA;
+    int epochs = EPOCHS;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (arg == "--hidden" && i + 1 < argc)
+        {
+            hiddenLayers = parseHiddenSizes(argv[++i]);
+        }
+        else if (arg == "--temperature" && i + 1 < argc)
+        {
+            temperature = std::stod(argv[++i]);
+        }
+        else if (arg == "--alpha" && i + 1 < argc)
+        {
+            alpha = std::stod(argv[++i]);
+        }
+        else if (arg == "--epochs" && i + 1 < argc)
+        {
+            epochs = std::stoi(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            teacherPath = arg;
+        }
+    }
+    if (outputPath.empty())
+    {
+        outputPath = "models/student";
+        for (int size : hiddenLayers)
+        {
+            outputPath += "_" + std::to_string(size);
+        }
+    }
+    distillModel(teacherPath, outputPath, hiddenLayers, temperature, alpha, epochs);
+    return 0;
+}
+
 //============================================================================
 // Main Entry
 //============================================================================
 
-int main()
+int main(int argc, char **argv)
 {
     try
     {
+        if (argc > 1)
+        {
+            std::string command = argv[1];
+            if (command == "calibrate")
+            {
+                return runCalibrate(argc, argv);
+            }
+            if (command == "prune")
+            {
+                return runPrune(argc, argv);
+            }
+            if (command == "distill")
+            {
+                return runDistill(argc, argv);
+            }
+            printUsage();
+            return command == "--help" ? 0 : 1;
+        }
+
         // Uncomment the following line to train a new model.
         // train();
 
+        // Or this one to stream training data that doesn't fit in memory.
+        // trainStreaming();
+
         // Quick test on 20 samples with detailed output
-        loadModel("models/model_0.01_100_60000_128_64");
+        loadModel(DEFAULT_MODEL);
 
         // Comprehensive evaluation on full test set
-        evaluateModel("models/model_0.01_100_60000_128_64");
+        evaluateModel(DEFAULT_MODEL);
     }
     catch (const std::exception &e)
     {
@@ -9,6 +9,7 @@
 
 #include <opencv2/opencv.hpp>
 #include "../../mlp/include/mlp.h"
+#include "model_watcher.hpp"
 
 //============================================================================
 // Parameters
@@ -21,10 +22,6 @@ const int DRAW_INPUT_SIZE = DRAW_INPUT_WIDTH * DRAW_INPUT_HEIGHT;
 
 const int OUTPUT_SIZE = 10;
 
-// Define two hidden layers for the MLP.
-const int HIDDEN_NEURONS_LAYER1 = 128;
-const int HIDDEN_NEURONS_LAYER2 = 64;
-
 // Improved brush settings
 const float BRUSH_RADIUS = 3.0f;
 const float BRUSH_SOFTNESS = 1.5f;
@@ -407,11 +404,9 @@ void onMouse(int event, int x, int y, int flags, void *userdata)
                 std::vector<unsigned char> pixels(processed.datastart, processed.dataend);
                 std::vector<double> normalized = normalizePixels(pixels);
 
-                std::vector<int> hiddenLayers = {HIDDEN_NEURONS_LAYER1, HIDDEN_NEURONS_LAYER2};
-                MLP mlp(DRAW_INPUT_SIZE, hiddenLayers, OUTPUT_SIZE, 0.01);
-                mlp.loadModel("models/model_0.01_100_60000_128_64");
-
-                lastPrediction = mlp.forward(normalized);
+                // The model stays loaded; the watcher swaps in a new one when the file changes.
+                std::shared_ptr<const MLP> mlp = static_cast<ModelWatcher *>(userdata)->current();
+                lastPrediction = mlp->forward(normalized);
 
                 auto maxIt = std::max_element(lastPrediction.begin(), lastPrediction.end());
                 predictedDigit = static_cast<int>(std::distance(lastPrediction.begin(), maxIt));
@@ -451,9 +446,12 @@ void forwardDraw(const std::string &modelPath = "models/model_0.01_100_60000_128
     // Initialize
     drawCanvas = cv::Mat::zeros(CANVAS_SIZE, CANVAS_SIZE, CV_8UC1);
 
+    // Load the model once for the whole session
+    ModelWatcher modelWatcher(modelPath, DRAW_INPUT_SIZE, OUTPUT_SIZE);
+
     // Create single window
     cv::namedWindow("MNIST Digit Recognizer", cv::WINDOW_AUTOSIZE);
-    cv::setMouseCallback("MNIST Digit Recognizer", onMouse, nullptr);
+    cv::setMouseCallback("MNIST Digit Recognizer", onMouse, &modelWatcher);
 
     // Initial window update
     updateMainWindow();
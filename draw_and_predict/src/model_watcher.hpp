@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../../mlp/include/mlp.h"
+
+// Holds the model for the lifetime of the app and reloads it in the
+// background when the file changes on disk. Readers take a shared_ptr to
+// the current model, so a reload never blocks or invalidates a prediction
+// that is running; the old model is freed once its last reader is done.
+class ModelWatcher
+{
+public:
+    // Loads the model immediately; throws if that fails or if the model
+    // does not have the expected input and output sizes.
+    ModelWatcher(const std::string &modelPath, int inputSize, int outputSize,
+                 std::chrono::milliseconds pollInterval = std::chrono::milliseconds(500))
+        : m_modelPath(modelPath), m_inputSize(inputSize), m_outputSize(outputSize),
+          m_pollInterval(pollInterval)
+    {
+        m_loadedStamp = stamp();
+        m_model = load();
+        m_thread = std::thread([this]
+                               { watch(); });
+    }
+
+    ~ModelWatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    ModelWatcher(const ModelWatcher &) = delete;
+    ModelWatcher &operator=(const ModelWatcher &) = delete;
+
+    std::shared_ptr<const MLP> current() const
+    {
+        return std::atomic_load(&m_model);
+    }
+
+private:
+    // Modification time and size identify a version of the file.
+    struct FileStamp
+    {
+        std::filesystem::file_time_type time;
+        std::uintmax_t size = 0;
+
+        bool operator==(const FileStamp &other) const { return time == other.time && size == other.size; }
+        bool operator!=(const FileStamp &other) const { return !(*this == other); }
+    };
+
+    std::string m_modelPath;
+    int m_inputSize;
+    int m_outputSize;
+    std::chrono::milliseconds m_pollInterval;
+    std::shared_ptr<const MLP> m_model;
+    FileStamp m_loadedStamp;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+
+    FileStamp stamp() const
+    {
+        FileStamp result;
+        std::error_code ec;
+        result.time = std::filesystem::last_write_time(m_modelPath, ec);
+        result.size = std::filesystem::file_size(m_modelPath, ec);
+        return result;
+    }
+
+    // The weights are copied rather than mapped so the file can be replaced again.
+    std::shared_ptr<const MLP> load() const
+    {
+        auto model = std::make_shared<MLP>(MLP::fromFile(m_modelPath, false));
+        if (model->inputSize() != m_inputSize || model->outputSize() != m_outputSize)
+        {
+            throw std::runtime_error("Model has the wrong number of inputs or outputs: " + m_modelPath);
+        }
+        return model;
+    }
+
+    void watch()
+    {
+        FileStamp previous = m_loadedStamp;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_wake.wait_for(lock, m_pollInterval, [this]
+                                { return m_stopping; }))
+        {
+            // Only reload once the file has stopped changing for one interval,
+            // so a model that is still being written is not picked up.
+            FileStamp current = stamp();
+            bool settled = current == previous;
+            previous = current;
+            if (!settled || current == m_loadedStamp)
+            {
+                continue;
+            }
+
+            lock.unlock();
+            try
+            {
+                std::atomic_store(&m_model, load());
+                std::cout << "Model reloaded from " << m_modelPath << std::endl;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Keeping the current model, reload failed: " << e.what() << std::endl;
+            }
+            lock.lock();
+            m_loadedStamp = current;
+        }
+    }
+};
@@ -0,0 +1,430 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BatchingOptions
+{
+    // Hard upper limit on the batch size in either mode.
+    size_t maxBatch = 64;
+
+    // Fixed mode: a batch runs once maxBatch requests are waiting or the
+    // oldest of them has waited maxDelay.
+    std::chrono::microseconds maxDelay{2000};
+
+    // Adaptive mode when non-zero: batch size and wait time are chosen at
+    // runtime to keep the p99 latency under this target while the executors
+    // keep up with the load.
+    std::chrono::microseconds latencyTarget{0};
+
+    // Threads running batches.
+    int executors = 1;
+};
+
+// Snapshot of the scheduler's measurements and current decisions.
+struct SchedulerMetrics
+{
+    bool adaptive = false;
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+
+    // Measurements: arrival rate, batch cost model, recent queue-to-answer
+    // latency and the part of it spent queued before the batch started.
+    double arrivalRate = 0.0; // requests per second
+    double batchFixedUs = 0.0;
+    double batchPerRequestUs = 0.0;
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double queueP99Us = 0.0;
+    double queueDepth = 0.0; // smoothed requests waiting when a batch starts
+
+    // Decisions: a batch runs once targetBatch requests are waiting or the
+    // oldest has waited maxWaitUs, and never exceeds batchCap.
+    size_t targetBatch = 0;
+    size_t batchCap = 0;
+    double maxWaitUs = 0.0;
+    double headroom = 0.0;   // share of the latency target the plan may use
+    bool overloaded = false; // batches are sized for throughput
+};
+
+// Decides when the inference queue runs a batch and how large it is.
+//
+// In adaptive mode it keeps online measurements of the arrival rate, of a
+// linear model cost(b) = fixed + perRequest * b of the batch execution time
+// fitted to the batches run so far, of the queue depth when a batch starts,
+// and of the latency of recent requests, split into the time spent queued
+// and the total. From these it plans, for a budget of headroom * latencyTarget:
+//
+//   cap     the largest batch with cost(cap) <= budget / 2, so that a request
+//           arriving while a full batch runs still makes its deadline;
+//   target  the smallest batch with which the executors keep up with the
+//           arrival rate at TARGET_UTILIZATION, i.e. the lowest latency that
+//           still sustains the load; 1 at low load, cap under overload;
+//   wait    budget / 2 - cost(target), the longest the oldest request waits
+//           for the target batch to fill.
+//
+// The headroom starts at DEFAULT_HEADROOM and is lowered whenever the
+// measured p99 exceeds the target and raised again while it is well below.
+//
+// More requests waiting at the start of a batch than the cap admits means
+// the queue grows faster than batches of that size drain it, and smaller
+// batches would only make it worse. While that lasts the scheduler is
+// overloaded: the cap is raised to the throughput-optimal batch, the
+// smallest one with THROUGHPUT_EFFICIENCY of the throughput of an unbounded
+// batch, and the headroom is left alone, as the p99 is then queueing delay
+// that no batch size brings under the target.
+//
+// Batches that all have the same size can't tell the fixed cost from the
+// per-request one. So every PROBE_INTERVAL-th batch, or every other one while
+// the sizes seen are too alike for the fit, runs at another size: twice the
+// planned one if that many are queued, half of it otherwise. While the fit
+// can't separate the two costs, overloaded batches may grow to maxBatch.
+//
+// The scheduler is not synchronized; its owner calls it under a lock.
+class BatchScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Decision
+    {
+        size_t runCount;          // requests to take now; 0 means wait
+        Clock::time_point wakeAt; // when to decide again, if nothing arrives
+    };
+
+    explicit BatchScheduler(const BatchingOptions &options)
+        : m_options(options), m_queueDelays(LATENCY_WINDOW), m_latencies(LATENCY_WINDOW)
+    {
+        m_rateWindowStart = m_lastFeedback = Clock::now();
+        updatePlan();
+    }
+
+    bool adaptive() const { return m_options.latencyTarget.count() > 0; }
+
+    void onArrival(Clock::time_point now)
+    {
+        m_arrivalsInWindow++;
+        double elapsed = seconds(now - m_rateWindowStart);
+        if (elapsed >= RATE_WINDOW)
+        {
+            double rate = m_arrivalsInWindow / elapsed;
+            m_arrivalRate = m_rateInitialized ? RATE_SMOOTHING * rate + (1.0 - RATE_SMOOTHING) * m_arrivalRate : rate;
+            m_rateInitialized = true;
+            m_arrivalsInWindow = 0;
+            m_rateWindowStart = now;
+            updatePlan();
+        }
+    }
+
+    Decision decide(size_t queued, Clock::time_point oldestArrival, Clock::time_point now) const
+    {
+        if (!adaptive())
+        {
+            Clock::time_point deadline = oldestArrival + m_options.maxDelay;
+            if (queued >= m_options.maxBatch || now >= deadline)
+            {
+                return {std::min(queued, m_options.maxBatch), now};
+            }
+            return {0, deadline};
+        }
+
+        Clock::time_point latestStart =
+            oldestArrival + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_maxWait));
+        if (queued >= m_target || now >= latestStart)
+        {
+            size_t count = std::min(queued, m_cap);
+            if (m_probeNext)
+            {
+                count = queued > count ? std::min({queued, 2 * count, m_options.maxBatch}) : (count + 1) / 2;
+            }
+            return {count, now};
+        }
+        return {0, latestStart};
+    }
+
+    // Record that a batch starts while `queued` requests are waiting, itself included.
+    void onBatchStart(size_t queued)
+    {
+        if (!adaptive())
+        {
+            return;
+        }
+        const double depth = static_cast<double>(queued);
+        m_queueDepth = m_depthInitialized ? DEPTH_SMOOTHING * depth + (1.0 - DEPTH_SMOOTHING) * m_queueDepth : depth;
+        m_depthInitialized = true;
+        m_sinceProbe = m_probeNext ? 0 : m_sinceProbe + 1;
+        m_probeNext = m_sinceProbe + 1 >= (m_sizesSpread ? PROBE_INTERVAL : PROBE_INTERVAL_UNFITTED);
+        updatePlan();
+    }
+
+    // Record the execution time of a batch.
+    void onBatchDone(size_t size, double batchSeconds)
+    {
+        m_batches++;
+        m_requests += size;
+
+        const double x = static_cast<double>(size);
+        m_sumWeight = COST_DECAY * m_sumWeight + 1.0;
+        m_sumX = COST_DECAY * m_sumX + x;
+        m_sumY = COST_DECAY * m_sumY + batchSeconds;
+        m_sumXX = COST_DECAY * m_sumXX + x * x;
+        m_sumXY = COST_DECAY * m_sumXY + x * batchSeconds;
+        fitCostModel();
+        updatePlan();
+    }
+
+    // Record the time a request spent from arrival to the start of its
+    // batch, and from arrival to its answer.
+    void onLatency(double queuedMicroseconds, double microseconds, Clock::time_point now)
+    {
+        m_queueDelays[m_latencyNext] = queuedMicroseconds;
+        m_latencies[m_latencyNext] = microseconds;
+        m_latencyNext = (m_latencyNext + 1) % m_latencies.size();
+        m_latencyCount = std::min(m_latencyCount + 1, m_latencies.size());
+        m_sinceFeedback++;
+
+        if (!adaptive() || m_sinceFeedback < FEEDBACK_MIN_SAMPLES || seconds(now - m_lastFeedback) < FEEDBACK_INTERVAL)
+        {
+            return;
+        }
+        const double target = static_cast<double>(m_options.latencyTarget.count());
+        double p99 = percentile(m_latencies, 0.99);
+        if (m_overloaded)
+        {
+            // Queueing behind a backlog; less headroom would only shrink the batches.
+        }
+        else if (p99 > target)
+        {
+            m_headroom = std::max(MIN_HEADROOM, m_headroom * HEADROOM_DECREASE);
+        }
+        else if (p99 < HEADROOM_RELAX_BELOW * target)
+        {
+            m_headroom = std::min(MAX_HEADROOM, m_headroom * HEADROOM_INCREASE);
+        }
+        m_sinceFeedback = 0;
+        m_lastFeedback = now;
+        updatePlan();
+    }
+
+    SchedulerMetrics metrics() const
+    {
+        SchedulerMetrics metrics;
+        metrics.adaptive = adaptive();
+        metrics.requests = m_requests;
+        metrics.batches = m_batches;
+        metrics.arrivalRate = m_arrivalRate;
+        metrics.batchFixedUs = m_costFixed * 1e6;
+        metrics.batchPerRequestUs = m_costPerRequest * 1e6;
+        metrics.p50Us = percentile(m_latencies, 0.50);
+        metrics.p99Us = percentile(m_latencies, 0.99);
+        metrics.queueP99Us = percentile(m_queueDelays, 0.99);
+        if (adaptive())
+        {
+            metrics.queueDepth = m_queueDepth;
+            metrics.targetBatch = m_target;
+            metrics.batchCap = m_cap;
+            metrics.maxWaitUs = m_maxWait * 1e6;
+            metrics.headroom = m_headroom;
+            metrics.overloaded = m_overloaded;
+        }
+        else
+        {
+            metrics.targetBatch = metrics.batchCap = m_options.maxBatch;
+            metrics.maxWaitUs = static_cast<double>(m_options.maxDelay.count());
+            metrics.headroom = 1.0;
+        }
+        return metrics;
+    }
+
+private:
+    // Arrival rate: requests counted over windows of RATE_WINDOW seconds,
+    // smoothed exponentially.
+    static constexpr double RATE_WINDOW = 0.05;
+    static constexpr double RATE_SMOOTHING = 0.3;
+
+    // Weight of a batch in the cost model decays by this factor per batch.
+    static constexpr double COST_DECAY = 0.98;
+
+    // Weighted variance of the batch sizes the fit needs to tell the fixed
+    // cost from the per-request one.
+    static constexpr double MIN_SIZE_VARIANCE = 0.1;
+
+    // Batches between probes of another size, once the sizes are spread
+    // enough for the fit and while they aren't.
+    static constexpr size_t PROBE_INTERVAL = 16;
+    static constexpr size_t PROBE_INTERVAL_UNFITTED = 2;
+
+    // Smoothing of the queue depth seen at the start of each batch.
+    static constexpr double DEPTH_SMOOTHING = 0.1;
+
+    // Share of the executors' time the plan aims to keep busy.
+    static constexpr double TARGET_UTILIZATION = 0.8;
+
+    // Share of the throughput of an unbounded batch that overloaded batches aim for.
+    static constexpr double THROUGHPUT_EFFICIENCY = 0.9;
+
+    // p99 feedback on the share of the latency target the plan may use.
+    static constexpr double DEFAULT_HEADROOM = 0.8;
+    static constexpr double MIN_HEADROOM = 0.2;
+    static constexpr double MAX_HEADROOM = 0.95;
+    static constexpr double HEADROOM_DECREASE = 0.85;
+    static constexpr double HEADROOM_INCREASE = 1.05;
+    static constexpr double HEADROOM_RELAX_BELOW = 0.6;
+    static constexpr double FEEDBACK_INTERVAL = 0.2;
+    static constexpr size_t FEEDBACK_MIN_SAMPLES = 100;
+    static constexpr size_t LATENCY_WINDOW = 4096;
+
+    BatchingOptions m_options;
+
+    double m_arrivalRate = 0.0;
+    bool m_rateInitialized = false;
+    size_t m_arrivalsInWindow = 0;
+    Clock::time_point m_rateWindowStart;
+
+    // Exponentially weighted sums of (batch size, seconds) for the fit.
+    double m_sumWeight = 0.0, m_sumX = 0.0, m_sumY = 0.0, m_sumXX = 0.0, m_sumXY = 0.0;
+    double m_costFixed = 0.0;
+    double m_costPerRequest = 0.0;
+    bool m_costKnown = false;
+    bool m_sizesSpread = false;   // batch sizes vary enough for the fit
+    bool m_costSeparated = false; // fixed and per-request cost told apart
+    size_t m_sinceProbe = 0;
+    bool m_probeNext = false;
+
+    double m_queueDepth = 0.0;
+    bool m_depthInitialized = false;
+    bool m_overloaded = false;
+
+    // Rings of the recent queueing delays and latencies, in the same order.
+    std::vector<double> m_queueDelays;
+    std::vector<double> m_latencies;
+    size_t m_latencyNext = 0;
+    size_t m_latencyCount = 0;
+    size_t m_sinceFeedback = 0;
+    Clock::time_point m_lastFeedback;
+    double m_headroom = DEFAULT_HEADROOM;
+
+    uint64_t m_requests = 0;
+    uint64_t m_batches = 0;
+
+    size_t m_target = 1;
+    size_t m_cap = 1;
+    double m_maxWait = 0.0;
+
+    static double seconds(Clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    double cost(size_t size) const
+    {
+        return m_costFixed + m_costPerRequest * static_cast<double>(size);
+    }
+
+    // Least-squares line through the weighted observations. While all
+    // batches had about the same size the intercept can't be told apart from
+    // the slope, so the cost is taken as proportional to the size, which
+    // overestimates larger batches and errs on the side of latency until
+    // the probes have spread the sizes.
+    void fitCostModel()
+    {
+        const double meanX = m_sumX / m_sumWeight;
+        const double meanY = m_sumY / m_sumWeight;
+        const double varianceX = m_sumXX / m_sumWeight - meanX * meanX;
+        m_costKnown = true;
+        m_sizesSpread = varianceX > MIN_SIZE_VARIANCE;
+        m_costSeparated = false;
+        if (m_sizesSpread)
+        {
+            double slope = (m_sumXY / m_sumWeight - meanX * meanY) / varianceX;
+            double intercept = meanY - slope * meanX;
+            if (slope > 0.0 && intercept >= 0.0)
+            {
+                m_costPerRequest = slope;
+                m_costFixed = intercept;
+                return;
+            }
+            // A negative intercept means no fixed cost worth amortizing; a
+            // negative slope is noise.
+            m_costSeparated = slope > 0.0;
+        }
+        m_costPerRequest = meanY / meanX;
+        m_costFixed = 0.0;
+    }
+
+    // Smallest batch b with b / cost(b) >= efficiency / perRequest, or the
+    // larger one the executors need to keep up with the arrival rate.
+    double throughputOptimalBatch() const
+    {
+        const double maxBatch = static_cast<double>(m_options.maxBatch);
+        if (!m_costSeparated)
+        {
+            return maxBatch;
+        }
+        double size = THROUGHPUT_EFFICIENCY / (1.0 - THROUGHPUT_EFFICIENCY) * m_costFixed / m_costPerRequest;
+        const double service = m_options.executors - m_arrivalRate * m_costPerRequest;
+        size = service > 0.0 ? std::max(size, m_arrivalRate * m_costFixed / service) : maxBatch;
+        return std::ceil(size);
+    }
+
+    void updatePlan()
+    {
+        if (!adaptive())
+        {
+            return;
+        }
+        const size_t maxBatch = m_options.maxBatch;
+        const double budget = m_headroom * std::chrono::duration<double>(m_options.latencyTarget).count();
+
+        // Nothing measured yet: run requests one by one until the first batches are timed.
+        if (!m_costKnown)
+        {
+            m_cap = m_target = 1;
+            m_maxWait = 0.0;
+            return;
+        }
+
+        double capacity = m_costPerRequest > 0.0 ? (budget / 2.0 - m_costFixed) / m_costPerRequest
+                                                 : static_cast<double>(maxBatch);
+        const size_t latencyCap =
+            static_cast<size_t>(std::clamp(std::floor(capacity), 1.0, static_cast<double>(maxBatch)));
+
+        // The queue outgrows batches of latencyCap: size them for throughput.
+        m_overloaded = m_queueDepth > static_cast<double>(latencyCap);
+        m_cap = latencyCap;
+        if (m_overloaded)
+        {
+            double size = std::max(throughputOptimalBatch(), static_cast<double>(latencyCap));
+            m_cap = static_cast<size_t>(std::min(size, static_cast<double>(maxBatch)));
+        }
+
+        // Smallest b with rate * cost(b) <= executors * utilization * b.
+        const double service = m_options.executors * TARGET_UTILIZATION - m_arrivalRate * m_costPerRequest;
+        if (service <= 0.0)
+        {
+            m_target = latencyCap;
+        }
+        else
+        {
+            double needed = std::ceil(m_arrivalRate * m_costFixed / service);
+            m_target = static_cast<size_t>(std::clamp(needed, 1.0, static_cast<double>(latencyCap)));
+        }
+        m_maxWait = std::max(0.0, budget / 2.0 - cost(m_target));
+    }
+
+    double percentile(const std::vector<double> &ring, double q) const
+    {
+        if (m_latencyCount == 0)
+        {
+            return 0.0;
+        }
+        std::vector<double> samples(ring.begin(), ring.begin() + m_latencyCount);
+        size_t rank = std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()));
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+        return samples[rank];
+    }
+};
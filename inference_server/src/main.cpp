@@ -0,0 +1,281 @@
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+
+#include "../../mlp/include/mlp.h"
+#include "socket.hpp"
+#include "protocol.hpp"
+#include "micro_batcher.hpp"
+#include "overload_simulation.hpp"
+
+//============================================================================
+// Parameters
+//============================================================================
+const std::string DEFAULT_MODEL = "models/model_0.01_100_60000_128_64";
+const size_t DEFAULT_MAX_BATCH = 64;
+const int DEFAULT_MAX_DELAY_US = 2000;
+const int DEFAULT_EXECUTORS = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+const int DEFAULT_METRICS_INTERVAL = 5;
+
+// Latency target of the adaptive run of --simulate when --slo-us is not given.
+const int DEFAULT_SIMULATION_SLO_US = 2000;
+
+//============================================================================
+// Helper Functions
+//============================================================================
+
+void printUsage()
+{
+    std::cout << "Usage: inference_server [model] [options]\n"
+              << "\n"
+              << "Loads a model once and classifies 784-byte MNIST images sent over\n"
+              << "localhost TCP, running concurrent requests as micro-batches.\n"
+              << "With --slo-us the batch size and wait time adapt at runtime to keep\n"
+              << "the p99 latency under the target, and grow for throughput while the\n"
+              << "queue outgrows that; otherwise they are fixed.\n"
+              << "\n"
+              << "Options:\n"
+              << "  --port <n>              TCP port on 127.0.0.1 (default: " << DEFAULT_PORT << ")\n"
+              << "  --max-batch <n>         largest micro-batch (default: " << DEFAULT_MAX_BATCH << ")\n"
+              << "  --max-delay-us <n>      fixed mode: longest wait for a batch to fill (default: " << DEFAULT_MAX_DELAY_US << ")\n"
+              << "  --slo-us <n>            adaptive mode: p99 latency target\n"
+              << "  --executors <n>         threads running batches (default: one per hardware thread, " << DEFAULT_EXECUTORS << ")\n"
+              << "  --metrics-interval <s>  seconds between metrics lines, 0 for none (default: " << DEFAULT_METRICS_INTERVAL << ")\n"
+              << "  --simulate              instead of serving, run fixed and adaptive batching against a\n"
+              << "                          simulated overloaded queue and report whether each keeps up" << std::endl;
+}
+
+// Print the scheduler's measurements and decisions every interval while requests come in.
+void reportMetrics(const MicroBatcher &batcher, int intervalSeconds)
+{
+    uint64_t previousRequests = 0;
+    uint64_t previousBatches = 0;
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
+        SchedulerMetrics m = batcher.metrics();
+        uint64_t requests = m.requests - previousRequests;
+        uint64_t batches = m.batches - previousBatches;
+        previousRequests = m.requests;
+        previousBatches = m.batches;
+        if (requests == 0)
+        {
+            continue;
+        }
+
+        std::cout << std::fixed << std::setprecision(0)
+                  << "[metrics] " << static_cast<double>(requests) / intervalSeconds << " req/s"
+                  << ", mean batch " << std::setprecision(1) << static_cast<double>(requests) / batches
+                  << ", p50 " << std::setprecision(0) << m.p50Us << " us, p99 " << m.p99Us << " us"
+                  << " (queued " << m.queueP99Us << " us)"
+                  << " | batch target " << m.targetBatch << ", cap " << m.batchCap
+                  << ", max wait " << m.maxWaitUs << " us";
+        if (m.adaptive)
+        {
+            std::cout << " | arrivals " << m.arrivalRate << "/s, queue " << std::setprecision(1) << m.queueDepth
+                      << ", cost " << m.batchFixedUs << " us + " << m.batchPerRequestUs << " us/req"
+                      << ", headroom " << std::setprecision(2) << m.headroom;
+            if (m.overloaded)
+            {
+                std::cout << ", overloaded";
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Compare both batching modes on a simulated queue that batches of one
+// request can't keep up with; returns false if adaptive batching falls
+// behind while fixed batching keeps up.
+bool runSimulation(BatchingOptions batching)
+{
+    SimulatedLoad load;
+    std::cout << "Simulated load: " << std::fixed << std::setprecision(0) << load.arrivalRate
+              << " requests/s for " << load.seconds << " s, batches of b requests take " << load.fixedUs
+              << " us + " << load.perRequestUs << " us * b, " << batching.executors << " executor"
+              << (batching.executors == 1 ? "" : "s") << "\n"
+              << std::endl;
+
+    std::chrono::microseconds latencyTarget = batching.latencyTarget;
+    if (latencyTarget.count() == 0)
+    {
+        latencyTarget = std::chrono::microseconds(DEFAULT_SIMULATION_SLO_US);
+    }
+    batching.latencyTarget = std::chrono::microseconds(0);
+    SimulationResult fixed = simulateQueue(batching, load);
+    batching.latencyTarget = latencyTarget;
+    SimulationResult adaptive = simulateQueue(batching, load);
+
+    for (const SimulationResult *result : {&fixed, &adaptive})
+    {
+        const SchedulerMetrics &m = result->metrics;
+        std::cout << std::setprecision(0) << std::left << std::setw(10) << (m.adaptive ? "adaptive" : "fixed")
+                  << std::right << result->throughput << " req/s, p99 " << result->p99Us << " us, mean batch "
+                  << std::setprecision(1) << static_cast<double>(m.requests) / std::max<uint64_t>(m.batches, 1)
+                  << ", cap " << m.batchCap << ", " << result->backlog << " still queued";
+        if (m.adaptive)
+        {
+            std::cout << " | cost " << m.batchFixedUs << " us + " << m.batchPerRequestUs << " us/req, headroom "
+                      << std::setprecision(2) << m.headroom << (m.overloaded ? ", overloaded" : "");
+        }
+        std::cout << std::endl;
+    }
+
+    // A queue of more than one round of full batches has fallen behind.
+    const size_t behind = batching.maxBatch * batching.executors;
+    bool keptUp = adaptive.backlog <= behind || fixed.backlog > behind;
+    std::cout << "\nAdaptive batching " << (keptUp ? "keeps up" : "falls behind") << std::endl;
+    return keptUp;
+}
+
+//============================================================================
+// Connection Handling
+//============================================================================
+
+// Serve one client until it disconnects: each request is queued with the
+// batcher and answered once its batch has run.
+void serveConnection(Socket connection, MicroBatcher &batcher)
+{
+    unsigned char image[IMAGE_BYTES];
+    unsigned char response[RESPONSE_BYTES];
+    try
+    {
+        while (connection.receiveAll(image, IMAGE_BYTES))
+        {
+            Prediction prediction = batcher.submit(image).get();
+            encodePrediction(prediction, response);
+            connection.sendAll(response, RESPONSE_BYTES);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Connection closed: " << e.what() << std::endl;
+    }
+}
+
+//============================================================================
+// Main
+//============================================================================
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        std::string modelPath = DEFAULT_MODEL;
+        int port = DEFAULT_PORT;
+        size_t maxBatch = DEFAULT_MAX_BATCH;
+        int maxDelayUs = DEFAULT_MAX_DELAY_US;
+        int executors = DEFAULT_EXECUTORS;
+        int sloUs = 0;
+        int metricsInterval = DEFAULT_METRICS_INTERVAL;
+        bool simulate = false;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--port" && i + 1 < argc)
+            {
+                port = std::stoi(argv[++i]);
+            }
+            else if (arg == "--max-batch" && i + 1 < argc)
+            {
+                maxBatch = static_cast<size_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--max-delay-us" && i + 1 < argc)
+            {
+                maxDelayUs = std::stoi(argv[++i]);
+            }
+            else if (arg == "--slo-us" && i + 1 < argc)
+            {
+                sloUs = std::stoi(argv[++i]);
+            }
+            else if (arg == "--executors" && i + 1 < argc)
+            {
+                executors = std::stoi(argv[++i]);
+            }
+            else if (arg == "--metrics-interval" && i + 1 < argc)
+            {
+                metricsInterval = std::stoi(argv[++i]);
+            }
+            else if (arg == "--simulate")
+            {
+                simulate = true;
+            }
+            else if (arg == "--help" || arg.rfind("--", 0) == 0)
+            {
+                printUsage();
+                return arg == "--help" ? 0 : 1;
+            }
+            else
+            {
+                modelPath = arg;
+            }
+        }
+        if (port <= 0 || port > 65535)
+        {
+            throw std::invalid_argument("Port out of range.");
+        }
+
+        BatchingOptions batching;
+        batching.maxBatch = maxBatch;
+        batching.maxDelay = std::chrono::microseconds(maxDelayUs);
+        batching.latencyTarget = std::chrono::microseconds(std::max(sloUs, 0));
+        batching.executors = executors;
+        if (simulate)
+        {
+            if (maxBatch == 0 || executors <= 0)
+            {
+                throw std::invalid_argument("Invalid micro-batching configuration.");
+            }
+            return runSimulation(batching) ? 0 : 1;
+        }
+
+        // One model for all connections; inference is const, so it is shared.
+        const MLP mlp = MLP::fromFile(modelPath);
+        MicroBatcher batcher(mlp, batching);
+
+        SocketLibrary sockets;
+        Socket listener = Socket::listenLocal(static_cast<uint16_t>(port));
+        std::cout << "Serving " << modelPath << " on 127.0.0.1:" << port << " (max batch " << maxBatch << ", ";
+        if (sloUs > 0)
+        {
+            std::cout << "adaptive batching for p99 < " << sloUs << " us, ";
+        }
+        else
+        {
+            std::cout << "max delay " << maxDelayUs << " us, ";
+        }
+        std::cout << executors << " executor" << (executors == 1 ? "" : "s") << ")" << std::endl;
+
+        if (metricsInterval > 0)
+        {
+            std::thread(reportMetrics, std::cref(batcher), metricsInterval).detach();
+        }
+
+        // The server runs until it is killed, so connection threads are detached.
+        while (true)
+        {
+            Socket connection;
+            try
+            {
+                connection = listener.accept();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << e.what() << std::endl;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            std::thread(serveConnection, std::move(connection), std::ref(batcher)).detach();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../../mlp/include/mlp.h"
+#include "protocol.hpp"
+#include "batch_scheduler.hpp"
+
+// Coalesces concurrent classification requests into micro-batches for
+// MLP::forwardBatch. When a batch runs and how large it is is decided by a
+// BatchScheduler, either from fixed limits or adaptively against a latency
+// target. The executor threads share the model, each with its own
+// InferenceContext.
+class MicroBatcher
+{
+public:
+    /**
+     * @param mlp Model to run; must outlive the batcher and must not change while it runs.
+     * @param options Batch size limit, batching mode and number of executor threads.
+     */
+    MicroBatcher(const MLP &mlp, const BatchingOptions &options)
+        : m_mlp(mlp), m_maxBatch(options.maxBatch), m_scheduler(options)
+    {
+        if (options.maxBatch == 0 || options.executors <= 0)
+        {
+            throw std::invalid_argument("Invalid micro-batching configuration.");
+        }
+        if (m_mlp.inputSize() != static_cast<int>(IMAGE_BYTES) || m_mlp.outputSize() != NUM_CLASSES)
+        {
+            throw std::invalid_argument("The model must have 784 inputs and 10 outputs.");
+        }
+        for (int i = 0; i < options.executors; ++i)
+        {
+            m_executors.emplace_back([this]
+                                     { executorLoop(); });
+        }
+    }
+
+    // Requests still queued are abandoned; their futures report a broken promise.
+    ~MicroBatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread &executor : m_executors)
+        {
+            executor.join();
+        }
+    }
+
+    MicroBatcher(const MicroBatcher &) = delete;
+    MicroBatcher &operator=(const MicroBatcher &) = delete;
+
+    // Queue an image of IMAGE_BYTES pixels; the pixels are copied.
+    std::future<Prediction> submit(const unsigned char *image)
+    {
+        Request request;
+        std::copy(image, image + IMAGE_BYTES, request.pixels.begin());
+        request.arrival = Clock::now();
+        std::future<Prediction> result = request.result.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_scheduler.onArrival(request.arrival);
+            m_queue.push_back(std::move(request));
+        }
+        m_wake.notify_all();
+        return result;
+    }
+
+    SchedulerMetrics metrics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_scheduler.metrics();
+    }
+
+private:
+    using Clock = BatchScheduler::Clock;
+
+    struct Request
+    {
+        std::array<unsigned char, IMAGE_BYTES> pixels;
+        Clock::time_point arrival;
+        std::promise<Prediction> result;
+    };
+
+    const MLP &m_mlp;
+    size_t m_maxBatch;
+
+    mutable std::mutex m_mutex;
+    BatchScheduler m_scheduler;
+    std::condition_variable m_wake;
+    std::deque<Request> m_queue;
+    bool m_stopping = false;
+    std::vector<std::thread> m_executors;
+
+    // Collect the next batch; returns false when the batcher is shutting down.
+    bool takeBatch(std::vector<Request> &batch)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t count = 0;
+        while (true)
+        {
+            if (m_stopping)
+            {
+                return false;
+            }
+            if (m_queue.empty())
+            {
+                m_wake.wait(lock);
+                continue;
+            }
+            // Decide again on every arrival and whenever the wait runs out.
+            BatchScheduler::Decision decision = m_scheduler.decide(m_queue.size(), m_queue.front().arrival, Clock::now());
+            if (decision.runCount > 0)
+            {
+                count = decision.runCount;
+                break;
+            }
+            m_wake.wait_until(lock, decision.wakeAt);
+        }
+
+        m_scheduler.onBatchStart(m_queue.size());
+        batch.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            batch.push_back(std::move(m_queue.front()));
+            m_queue.pop_front();
+        }
+        return true;
+    }
+
+    void executorLoop()
+    {
+        InferenceContext context;
+        std::vector<Request> batch;
+        std::vector<double> inputs(m_maxBatch * IMAGE_BYTES);
+        std::vector<double> probabilities(m_maxBatch * NUM_CLASSES);
+
+        while (takeBatch(batch))
+        {
+            try
+            {
+                auto start = Clock::now();
+                for (size_t i = 0; i < batch.size(); ++i)
+                {
+                    Dataset::normalize(batch[i].pixels.data(), IMAGE_BYTES, inputs.data() + i * IMAGE_BYTES);
+                }
+                m_mlp.forwardBatch(inputs.data(), batch.size(), probabilities.data(), context);
+
+                for (size_t i = 0; i < batch.size(); ++i)
+                {
+                    const double *row = probabilities.data() + i * NUM_CLASSES;
+                    Prediction prediction;
+                    prediction.digit = static_cast<int>(std::max_element(row, row + NUM_CLASSES) - row);
+                    std::copy(row, row + NUM_CLASSES, prediction.probabilities);
+                    batch[i].result.set_value(prediction);
+                }
+                // The batch cost includes answering, which takes the executor's time as well.
+                auto finish = Clock::now();
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_scheduler.onBatchDone(batch.size(), std::chrono::duration<double>(finish - start).count());
+                for (const Request &request : batch)
+                {
+                    m_scheduler.onLatency(std::chrono::duration<double, std::micro>(start - request.arrival).count(),
+                                          std::chrono::duration<double, std::micro>(finish - request.arrival).count(), finish);
+                }
+            }
+            catch (...)
+            {
+                for (Request &request : batch)
+                {
+                    try
+                    {
+                        request.result.set_exception(std::current_exception());
+                    }
+                    catch (const std::future_error &)
+                    {
+                        // Already answered before the failure.
+                    }
+                }
+            }
+        }
+    }
+};
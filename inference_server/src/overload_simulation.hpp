@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "batch_scheduler.hpp"
+
+// Synthetic load for simulateQueue: Poisson arrivals at arrivalRate for
+// `seconds`, and batches of b requests that take fixedUs + perRequestUs * b.
+struct SimulatedLoad
+{
+    double arrivalRate = 20000.0;
+    double fixedUs = 400.0;
+    double perRequestUs = 15.0;
+    double seconds = 5.0;
+};
+
+struct SimulationResult
+{
+    double throughput = 0.0; // requests answered per second
+    double p99Us = 0.0;
+    size_t backlog = 0; // requests still queued at the end
+    SchedulerMetrics metrics;
+};
+
+// Run a BatchScheduler against the load on a simulated clock, with the
+// executors and batching mode of options. Nothing is computed, so this
+// shows in a moment whether the scheduler keeps up with a queue that a
+// given cost model overloads.
+inline SimulationResult simulateQueue(const BatchingOptions &options, const SimulatedLoad &load)
+{
+    using Clock = BatchScheduler::Clock;
+    const double never = std::numeric_limits<double>::infinity();
+    const Clock::time_point begin = Clock::now();
+    auto at = [&](double seconds)
+    {
+        return begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    };
+
+    struct Running
+    {
+        double start = 0.0;
+        double finish = 0.0;
+        std::vector<double> arrivals; // empty while the executor is idle
+    };
+
+    BatchScheduler scheduler(options);
+    std::mt19937 random(12345);
+    std::exponential_distribution<double> gap(load.arrivalRate);
+    std::deque<double> queue; // arrival times
+    std::vector<Running> executors(options.executors);
+    std::vector<double> latencies;
+    double nextArrival = gap(random);
+    double wakeAt = never;
+
+    while (true)
+    {
+        double now = std::min(nextArrival, wakeAt);
+        for (const Running &running : executors)
+        {
+            if (!running.arrivals.empty())
+            {
+                now = std::min(now, running.finish);
+            }
+        }
+        if (now >= load.seconds)
+        {
+            break;
+        }
+
+        for (Running &running : executors)
+        {
+            if (running.arrivals.empty() || running.finish > now)
+            {
+                continue;
+            }
+            scheduler.onBatchDone(running.arrivals.size(), running.finish - running.start);
+            for (double arrival : running.arrivals)
+            {
+                latencies.push_back((running.finish - arrival) * 1e6);
+                scheduler.onLatency((running.start - arrival) * 1e6, latencies.back(), at(running.finish));
+            }
+            running.arrivals.clear();
+        }
+        if (nextArrival <= now)
+        {
+            queue.push_back(nextArrival);
+            scheduler.onArrival(at(nextArrival));
+            nextArrival += gap(random);
+        }
+
+        wakeAt = never;
+        for (Running &running : executors)
+        {
+            if (queue.empty())
+            {
+                break;
+            }
+            if (!running.arrivals.empty())
+            {
+                continue;
+            }
+            BatchScheduler::Decision decision = scheduler.decide(queue.size(), at(queue.front()), at(now));
+            if (decision.runCount == 0)
+            {
+                // Step past rounding of the wake-up time back to seconds.
+                wakeAt = std::max(std::chrono::duration<double>(decision.wakeAt - begin).count(), now + 1e-7);
+                break;
+            }
+            scheduler.onBatchStart(queue.size());
+            running.arrivals.assign(queue.begin(), queue.begin() + decision.runCount);
+            queue.erase(queue.begin(), queue.begin() + decision.runCount);
+            running.start = now;
+            running.finish = now + (load.fixedUs + load.perRequestUs * decision.runCount) * 1e-6;
+        }
+    }
+
+    SimulationResult result;
+    result.throughput = latencies.size() / load.seconds;
+    if (!latencies.empty())
+    {
+        size_t rank = std::min(latencies.size() - 1, static_cast<size_t>(0.99 * latencies.size()));
+        std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+        result.p99Us = latencies[rank];
+    }
+    result.backlog = queue.size();
+    result.metrics = scheduler.metrics();
+    return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Wire format of the inference server. A client sends any number of
+// requests over one connection and reads one response per request, in
+// order:
+//
+//   request   784 bytes      grayscale image, row-major, 0-255 (MNIST layout)
+//   response  1 byte         predicted digit
+//             10 x float32   class probabilities, little-endian
+//
+// The server only listens on localhost.
+
+const uint16_t DEFAULT_PORT = 7878;
+const size_t IMAGE_BYTES = 784;
+const int NUM_CLASSES = 10;
+const size_t RESPONSE_BYTES = 1 + NUM_CLASSES * sizeof(float);
+
+struct Prediction
+{
+    int digit = 0;
+    float probabilities[NUM_CLASSES] = {};
+};
+
+// Both ends run on the same x86 host, so floats are copied in host order.
+inline void encodePrediction(const Prediction &prediction, unsigned char *out)
+{
+    out[0] = static_cast<unsigned char>(prediction.digit);
+    std::memcpy(out + 1, prediction.probabilities, sizeof(prediction.probabilities));
+}
+
+inline Prediction decodePrediction(const unsigned char *in)
+{
+    Prediction prediction;
+    prediction.digit = in[0];
+    std::memcpy(prediction.probabilities, in + 1, sizeof(prediction.probabilities));
+    return prediction;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+const SocketHandle NO_SOCKET = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+const SocketHandle NO_SOCKET = -1;
+#endif
+
+// Keeps the platform socket library initialized (only Winsock needs this).
+class SocketLibrary
+{
+public:
+    SocketLibrary()
+    {
+#ifdef _WIN32
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        {
+            throw std::runtime_error("Failed to initialize Winsock.");
+        }
+#endif
+    }
+
+    ~SocketLibrary()
+    {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    SocketLibrary(const SocketLibrary &) = delete;
+    SocketLibrary &operator=(const SocketLibrary &) = delete;
+};
+
+// A TCP socket, closed when the object goes away. All sockets have Nagle's
+// algorithm disabled: requests and responses are small and latency bound.
+class Socket
+{
+public:
+    Socket() : m_handle(NO_SOCKET) {}
+    explicit Socket(SocketHandle handle) : m_handle(handle) {}
+    ~Socket() { close(); }
+
+    Socket(const Socket &) = delete;
+    Socket &operator=(const Socket &) = delete;
+    Socket(Socket &&other) noexcept : m_handle(other.m_handle) { other.m_handle = NO_SOCKET; }
+    Socket &operator=(Socket &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_handle = other.m_handle;
+            other.m_handle = NO_SOCKET;
+        }
+        return *this;
+    }
+
+    bool valid() const { return m_handle != NO_SOCKET; }
+
+    // Listen on 127.0.0.1 only; the server is not meant to be reachable from other hosts.
+    static Socket listenLocal(uint16_t port, int backlog = 128)
+    {
+        Socket socket(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        if (!socket.valid())
+        {
+            throw std::runtime_error("Failed to create a socket.");
+        }
+        int reuse = 1;
+        setsockopt(socket.m_handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(socket.m_handle, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+            listen(socket.m_handle, backlog) != 0)
+        {
+            throw std::runtime_error("Failed to listen on port " + std::to_string(port) + ".");
+        }
+        return socket;
+    }
+
+    static Socket connect(const std::string &host, uint16_t port)
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+        {
+            throw std::invalid_argument("Invalid IPv4 address: " + host);
+        }
+
+        Socket socket(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        if (!socket.valid() ||
+            ::connect(socket.m_handle, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            throw std::runtime_error("Failed to connect to " + host + ":" + std::to_string(port) + ".");
+        }
+        socket.setNoDelay();
+        return socket;
+    }
+
+    Socket accept() const
+    {
+        Socket connection(::accept(m_handle, nullptr, nullptr));
+        if (!connection.valid())
+        {
+            throw std::runtime_error("Failed to accept a connection.");
+        }
+        connection.setNoDelay();
+        return connection;
+    }
+
+    void sendAll(const void *data, size_t size) const
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            auto sent = ::send(m_handle, bytes, static_cast<int>(size), SEND_FLAGS);
+            if (sent <= 0)
+            {
+                throw std::runtime_error("Connection lost while sending.");
+            }
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+    }
+
+    // Receive exactly size bytes. Returns false if the peer closed the
+    // connection cleanly before sending anything; a message cut short throws.
+    bool receiveAll(void *data, size_t size) const
+    {
+        char *bytes = static_cast<char *>(data);
+        size_t received = 0;
+        while (received < size)
+        {
+            auto count = ::recv(m_handle, bytes + received, static_cast<int>(size - received), 0);
+            if (count == 0 && received == 0)
+            {
+                return false;
+            }
+            if (count <= 0)
+            {
+                throw std::runtime_error("Connection lost while receiving.");
+            }
+            received += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (valid())
+        {
+#ifdef _WIN32
+            closesocket(m_handle);
+#else
+            ::close(m_handle);
+#endif
+            m_handle = NO_SOCKET;
+        }
+    }
+
+private:
+    // A peer that has gone away must not kill the process with SIGPIPE.
+#ifdef MSG_NOSIGNAL
+    static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static const int SEND_FLAGS = 0;
+#endif
+
+    SocketHandle m_handle;
+
+    void setNoDelay()
+    {
+        int noDelay = 1;
+        setsockopt(m_handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof(noDelay));
+    }
+};
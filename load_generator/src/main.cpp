@@ -0,0 +1,265 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iomanip>
+#include <cstdlib>
+
+#include "socket.hpp"
+#include "protocol.hpp"
+
+//============================================================================
+// Parameters
+//============================================================================
+const std::string DEFAULT_HOST = "127.0.0.1";
+const std::string DEFAULT_TEST_FILE = "resources/training_data/mnist_test.csv";
+const int DEFAULT_CONNECTIONS = 16;
+const size_t DEFAULT_REQUESTS = 20000;
+
+// Images generated when no test set is available.
+const size_t RANDOM_IMAGES = 1000;
+
+//============================================================================
+// Helper Functions
+//============================================================================
+
+void printUsage()
+{
+    std::cout << "Usage: load_generator [options]\n"
+              << "\n"
+              << "Sends MNIST images to a running inference_server from several\n"
+              << "connections at once, each waiting for its response before sending\n"
+              << "the next request, and reports throughput and latency. With --rate the\n"
+              << "requests follow a fixed schedule instead, and latency is measured from\n"
+              << "the scheduled send time, so time a request spent waiting for a busy\n"
+              << "connection counts too.\n"
+              << "\n"
+              << "Options:\n"
+              << "  --host <ip>          server address (default: " << DEFAULT_HOST << ")\n"
+              << "  --port <n>           server port (default: " << DEFAULT_PORT << ")\n"
+              << "  --connections <n>    concurrent connections (default: " << DEFAULT_CONNECTIONS << ")\n"
+              << "  --requests <n>       total number of requests (default: " << DEFAULT_REQUESTS << ")\n"
+              << "  --rate <n>           offered load in requests/s (default: as fast as possible)\n"
+              << "  --test <csv>         images to send (default: " << DEFAULT_TEST_FILE << ";\n"
+              << "                       random images if the file does not exist)" << std::endl;
+}
+
+struct Workload
+{
+    std::vector<unsigned char> images; // IMAGE_BYTES per image
+    std::vector<int> labels;           // empty for random images
+
+    size_t size() const { return images.size() / IMAGE_BYTES; }
+};
+
+// Read "label,p0,...,p783" rows; returns false if the file can't be opened.
+bool loadTestSet(const std::string &path, Workload &workload)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line == "\r")
+        {
+            continue;
+        }
+        char *end = nullptr;
+        int label = static_cast<int>(std::strtol(line.c_str(), &end, 10));
+        for (size_t i = 0; i < IMAGE_BYTES; i++)
+        {
+            if (*end != ',')
+            {
+                throw std::runtime_error("Invalid row format in CSV file: " + path);
+            }
+            workload.images.push_back(static_cast<unsigned char>(std::strtol(end + 1, &end, 10)));
+        }
+        workload.labels.push_back(label);
+    }
+    return workload.size() > 0;
+}
+
+void generateRandomImages(Workload &workload)
+{
+    workload.images.resize(RANDOM_IMAGES * IMAGE_BYTES);
+    unsigned int state = 12345;
+    for (unsigned char &pixel : workload.images)
+    {
+        state = state * 1664525u + 1013904223u;
+        pixel = static_cast<unsigned char>(state >> 24);
+    }
+}
+
+// Latency at quantile q of sorted samples, by the nearest-rank method.
+double percentile(const std::vector<double> &sorted, double q)
+{
+    size_t rank = static_cast<size_t>(q * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+//============================================================================
+// Main
+//============================================================================
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        std::string host = DEFAULT_HOST;
+        int port = DEFAULT_PORT;
+        int connections = DEFAULT_CONNECTIONS;
+        size_t requests = DEFAULT_REQUESTS;
+        std::string testFile = DEFAULT_TEST_FILE;
+        double rate = 0.0;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--host" && i + 1 < argc)
+            {
+                host = argv[++i];
+            }
+            else if (arg == "--port" && i + 1 < argc)
+            {
+                port = std::stoi(argv[++i]);
+            }
+            else if (arg == "--connections" && i + 1 < argc)
+            {
+                connections = std::stoi(argv[++i]);
+            }
+            else if (arg == "--requests" && i + 1 < argc)
+            {
+                requests = static_cast<size_t>(std::stoull(argv[++i]));
+            }
+            else if (arg == "--rate" && i + 1 < argc)
+            {
+                rate = std::stod(argv[++i]);
+            }
+            else if (arg == "--test" && i + 1 < argc)
+            {
+                testFile = argv[++i];
+            }
+            else
+            {
+                printUsage();
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+        if (connections <= 0 || requests == 0 || port <= 0 || port > 65535)
+        {
+            throw std::invalid_argument("Connections, requests and port must be positive.");
+        }
+
+        Workload workload;
+        if (loadTestSet(testFile, workload))
+        {
+            std::cout << "Loaded " << workload.size() << " images from " << testFile << std::endl;
+        }
+        else
+        {
+            generateRandomImages(workload);
+            std::cout << "No test set at " << testFile << ", sending " << workload.size()
+                      << " random images" << std::endl;
+        }
+
+        SocketLibrary sockets;
+        std::vector<Socket> clients;
+        for (int c = 0; c < connections; c++)
+        {
+            clients.push_back(Socket::connect(host, static_cast<uint16_t>(port)));
+        }
+
+        // Requests are handed out from a shared counter, so fast connections
+        // take more of them; every connection records its own latencies.
+        std::atomic<size_t> nextRequest(0);
+        std::atomic<size_t> correct(0);
+        std::vector<std::vector<double>> latencies(connections);
+        std::vector<std::string> errors(connections);
+        std::vector<std::thread> threads;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int c = 0; c < connections; c++)
+        {
+            threads.emplace_back([&, c]
+                                 {
+                unsigned char response[RESPONSE_BYTES];
+                try
+                {
+                    for (size_t r = nextRequest++; r < requests; r = nextRequest++)
+                    {
+                        size_t image = r % workload.size();
+                        auto sent = std::chrono::steady_clock::now();
+                        if (rate > 0.0)
+                        {
+                            sent = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                               std::chrono::duration<double>(r / rate));
+                            std::this_thread::sleep_until(sent);
+                        }
+                        clients[c].sendAll(workload.images.data() + image * IMAGE_BYTES, IMAGE_BYTES);
+                        if (!clients[c].receiveAll(response, RESPONSE_BYTES))
+                        {
+                            throw std::runtime_error("Server closed the connection.");
+                        }
+                        auto received = std::chrono::steady_clock::now();
+                        latencies[c].push_back(std::chrono::duration<double, std::micro>(received - sent).count());
+
+                        if (!workload.labels.empty() && decodePrediction(response).digit == workload.labels[image])
+                        {
+                            correct++;
+                        }
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    errors[c] = e.what();
+                } });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> all;
+        for (int c = 0; c < connections; c++)
+        {
+            if (!errors[c].empty())
+            {
+                std::cerr << "Connection " << c << " failed: " << errors[c] << std::endl;
+            }
+            all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        }
+        if (all.empty())
+        {
+            throw std::runtime_error("No request completed.");
+        }
+        std::sort(all.begin(), all.end());
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "\nRequests:    " << all.size() << " over " << connections << " connections in "
+                  << std::setprecision(2) << seconds << " s\n"
+                  << std::setprecision(0)
+                  << "Throughput:  " << all.size() / seconds << " requests/s\n"
+                  << std::setprecision(1)
+                  << "Latency:     p50 " << percentile(all, 0.50) << " us, p99 " << percentile(all, 0.99)
+                  << " us, max " << all.back() << " us" << std::endl;
+        if (!workload.labels.empty())
+        {
+            std::cout << std::setprecision(2)
+                      << "Accuracy:    " << 100.0 * correct / all.size() << "%" << std::endl;
+        }
+        return all.size() == requests ? 0 : 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include "mlp_export.h"
+#include "mlp.h"
+#include "quantized_mlp.h"
+
+// How ActivationCalibrator turns a histogram into a range.
+enum class CalibrationMethod
+{
+    MinMax,     // smallest and largest value seen
+    Percentile, // clip the given share of values at each end
+    Entropy,    // upper end with the least KL divergence after quantization
+};
+
+// Post-training calibration for QuantizedMLP. Runs a network in double
+// precision over calibration samples and records, for every layer, the
+// smallest and largest input and a histogram of the inputs over [0, 1].
+// ranges() turns these into the input ranges QuantizedMLP maps onto its
+// 7-bit activations.
+class MLP_API ActivationCalibrator
+{
+public:
+    /**
+     * @param mlp Network to calibrate; must outlive the calibrator.
+     */
+    explicit ActivationCalibrator(const MLP &mlp);
+    ~ActivationCalibrator();
+
+    ActivationCalibrator(const ActivationCalibrator &) = delete;
+    ActivationCalibrator &operator=(const ActivationCalibrator &) = delete;
+
+    // Add `count` row-major samples of inputSize() values in [0, 1].
+    void observe(const double *inputs, size_t count);
+    void observe(const DatasetView &data);
+
+    size_t samples() const;
+
+    // Input range of every layer, for QuantizedMLP. percentile is the share
+    // of values kept at each end, in percent, for CalibrationMethod::Percentile.
+    std::vector<ActivationRange> ranges(CalibrationMethod method, double percentile = 99.99) const;
+
+    // Smallest and largest input seen by every layer.
+    std::vector<ActivationRange> observedRanges() const;
+
+private:
+    // PIMPL–style internal implementation.
+    struct Histograms;
+    Histograms *m_Histograms;
+};
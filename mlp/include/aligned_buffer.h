@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <algorithm>
+
+// Heap array aligned to a cache line, suitable for vector loads.
+template <typename T>
+class AlignedBuffer
+{
+public:
+    static const size_t ALIGNMENT = 64;
+
+    AlignedBuffer() : m_size(0) {}
+    explicit AlignedBuffer(size_t size) { resize(size); }
+
+    // Reallocate to the given size; previous contents are not preserved.
+    void resize(size_t size)
+    {
+        m_data.reset(size ? static_cast<T *>(::operator new[](size * sizeof(T), std::align_val_t(ALIGNMENT)))
+                          : nullptr);
+        m_size = size;
+    }
+
+    void fill(const T &value) { std::fill(data(), data() + m_size, value); }
+
+    T *data() { return m_data.get(); }
+    const T *data() const { return m_data.get(); }
+    size_t size() const { return m_size; }
+    T &operator[](size_t i) { return m_data[i]; }
+    const T &operator[](size_t i) const { return m_data[i]; }
+
+private:
+    struct Deleter
+    {
+        void operator()(T *p) const { ::operator delete[](p, std::align_val_t(ALIGNMENT)); }
+    };
+    std::unique_ptr<T[], Deleter> m_data;
+    size_t m_size;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "mlp_export.h"
+
+// Ranges for the random transformations applied by ImageAugmenter.
+struct AugmentationOptions
+{
+    double maxShift = 2.0;           // pixels, uniform in [-maxShift, maxShift] per axis
+    double maxRotationDegrees = 10.0; // uniform in [-max, max]
+    double minScale = 0.9;
+    double maxScale = 1.1;
+    double elasticAlpha = 1.0;       // std. deviation of the elastic displacement, pixels
+    int elasticGrid = 4;             // control points per axis of the displacement field (0 disables)
+    uint64_t seed = 0;
+};
+
+// On-the-fly augmentation of grayscale uint8 images: a random affine
+// transform (shift, rotation, scale) combined with a smooth elastic
+// distortion, resampled bilinearly. The random parameters are a pure
+// function of (seed, sample index, epoch), and apply() holds no mutable
+// state, so one instance can be shared by any number of loader threads.
+class MLP_API ImageAugmenter
+{
+public:
+    ImageAugmenter(int width, int height, const AugmentationOptions &options = AugmentationOptions());
+
+    // Transform width * height pixels in place.
+    void apply(unsigned char *pixels, size_t sampleIndex, int epoch) const;
+
+    // Adapter for BatchLoader::Augmenter / TrainingOptions::augment.
+    void operator()(unsigned char *pixels, size_t sampleIndex, int epoch) const
+    {
+        apply(pixels, sampleIndex, epoch);
+    }
+
+private:
+    int m_width;
+    int m_height;
+    AugmentationOptions m_options;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "mlp_export.h"
+#include "dataset.h"
+
+// Common interface of the training input pipelines.
+class MLP_API BatchProducer
+{
+public:
+    virtual ~BatchProducer() = default;
+
+    // Start producing the batches of the given epoch.
+    virtual void startEpoch(int epoch) = 0;
+
+    // Wait for the next batch of the current epoch. Returns false once the
+    // epoch is exhausted. The batch stays valid until the next call. An
+    // error while preparing a batch, e.g. thrown by the augmenter, is
+    // rethrown here on the calling thread.
+    virtual bool next(Batch &batch) = 0;
+
+    // Total time next() spent waiting for a batch that was not ready yet.
+    virtual double stallSeconds() const = 0;
+    virtual size_t batchesServed() const = 0;
+};
+
+// Background data loader. Worker threads gather batches of the dataset in
+// (optionally shuffled) epoch order, convert them to doubles and write them
+// into a ring of aligned buffers, so batch N+1 is prepared while the trainer
+// consumes batch N.
+class MLP_API BatchLoader : public BatchProducer
+{
+public:
+    // Optional per-sample augmentation, applied in place on a private copy
+    // of the raw pixels before normalization. Runs on the worker threads and
+    // must be safe to call concurrently.
+    using Augmenter = std::function<void(unsigned char *pixels, size_t datasetIndex, int epoch)>;
+
+    /**
+     * @param data Samples to iterate; the underlying Dataset must outlive the loader.
+     * @param batchSize Maximum number of rows per batch.
+     * @param shuffle Visit samples in a new permutation every epoch.
+     * @param seed Seed for the per-epoch permutation.
+     * @param prefetchDepth Number of batch buffers in the ring (at least 2).
+     * @param workers Number of worker threads filling buffers.
+     * @param augment Optional augmentation stage.
+     */
+    BatchLoader(const DatasetView &data, size_t batchSize, bool shuffle = true,
+                uint64_t seed = 0, int prefetchDepth = 3, int workers = 1,
+                Augmenter augment = nullptr);
+    ~BatchLoader();
+
+    BatchLoader(const BatchLoader &) = delete;
+    BatchLoader &operator=(const BatchLoader &) = delete;
+
+    // Any batches left over from the previous epoch are discarded.
+    void startEpoch(int epoch) override;
+    bool next(Batch &batch) override;
+
+    size_t batchesPerEpoch() const;
+
+    double stallSeconds() const override;
+    size_t batchesServed() const override;
+
+private:
+    // PIMPL–style internal implementation.
+    struct Pipeline;
+    Pipeline *m_Pipeline;
+};
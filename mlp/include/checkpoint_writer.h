@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "mlp_export.h"
+
+// Writes model files on a background thread so training never waits for
+// the disk. Each file is written to a temporary name and then renamed over
+// the target, so a crash leaves either the old or the new checkpoint intact.
+// If a path is submitted again before its previous image has been written,
+// only the newest image is kept.
+class MLP_API CheckpointWriter
+{
+public:
+    using Image = std::shared_ptr<const std::vector<unsigned char>>;
+
+    CheckpointWriter();
+    // Writes everything still pending before returning.
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // Queue a complete file image for writing; returns immediately.
+    void submit(const std::string &path, Image image);
+
+    // Wait until every submitted image is on disk. Rethrows the first write
+    // error since the last flush.
+    void flush();
+
+private:
+    // PIMPL–style internal implementation.
+    struct Worker;
+    Worker *m_Worker;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+// Counter-based random number generator. Every value is a pure function of
+// (seed, stream, counter), so any element of a sequence can be computed
+// independently: threads can split work without sharing state, and a run is
+// reproducible from the seed alone. The mixing function is SplitMix64.
+class CounterRng
+{
+public:
+    CounterRng(uint64_t seed, uint64_t stream = 0)
+        : m_key(mix(seed ^ mix(stream + 0x9E3779B97F4A7C15ULL))), m_counter(0) {}
+
+    // Value at an arbitrary position of the sequence.
+    uint64_t at(uint64_t counter) const
+    {
+        return mix(m_key + counter * 0x9E3779B97F4A7C15ULL);
+    }
+
+    uint64_t next() { return at(m_counter++); }
+
+    // Uniform double in [0, 1).
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Uniform double in [low, high).
+    double uniform(double low, double high) { return low + (high - low) * uniform(); }
+
+    // Uniform integer in [0, n).
+    uint64_t below(uint64_t n) { return n == 0 ? 0 : next() % n; }
+
+    // Standard normal sample (Box-Muller).
+    double normal()
+    {
+        double u1 = 1.0 - uniform(); // (0, 1]
+        double u2 = uniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+    }
+
+    uint64_t counter() const { return m_counter; }
+    void seek(uint64_t counter) { m_counter = counter; }
+
+private:
+    uint64_t m_key;
+    uint64_t m_counter;
+
+    static uint64_t mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
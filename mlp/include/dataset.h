@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "mlp_export.h"
+
+// A contiguous block of samples ready to be fed to the network.
+// Rows are stored back to back: inputs holds count * inputSize values and
+// targets holds count * outputSize one-hot values. indices holds the
+// dataset index of every row, or is null if the rows don't come from a
+// Dataset (streaming).
+struct Batch
+{
+    const double *inputs;
+    const double *targets;
+    const size_t *indices;
+    size_t count;
+    int inputSize;
+    int outputSize;
+};
+
+class MLP_API Dataset
+{
+public:
+    /**
+     * Creates an empty dataset.
+     * @param sampleSize Number of pixels per sample (784 for MNIST).
+     * @param numClasses Number of label classes (10 for MNIST).
+     */
+    Dataset(int sampleSize, int numClasses);
+    ~Dataset();
+
+    Dataset(Dataset &&other) noexcept;
+    Dataset &operator=(Dataset &&other) noexcept;
+    Dataset(const Dataset &) = delete;
+    Dataset &operator=(const Dataset &) = delete;
+
+    // Reserve storage for the given number of samples.
+    void reserve(size_t count);
+
+    // Append a sample. pixels must point to sampleSize() raw [0,255] values.
+    void addSample(const unsigned char *pixels, int label);
+
+    size_t size() const;
+    int sampleSize() const;
+    int numClasses() const;
+
+    // Raw access to the stored sample.
+    const unsigned char *pixels(size_t index) const;
+    int label(size_t index) const;
+
+    // Gather samples into contiguous row-major buffers, normalizing pixels
+    // to [0,1] and one-hot encoding the labels. Either output may be null.
+    void gather(const size_t *indices, size_t count,
+                double *inputs, double *targets) const;
+    void gatherRange(size_t first, size_t count,
+                     double *inputs, double *targets) const;
+
+    // Convert raw [0,255] pixels to normalized double values [0,1].
+    static void normalize(const unsigned char *pixels, size_t count, double *out);
+
+private:
+    // PIMPL–style internal storage.
+    struct Storage;
+    Storage *m_Storage;
+};
+
+// A lightweight, non-owning view over a Dataset: either a contiguous range
+// of samples or an index list. Splits, folds and subsets never copy pixels;
+// the viewed Dataset must outlive every view onto it.
+class DatasetView
+{
+public:
+    // View over the whole dataset.
+    DatasetView(const Dataset &data)
+        : m_data(&data), m_first(0), m_count(data.size()) {}
+
+    // View over the contiguous range [first, first + count).
+    DatasetView(const Dataset &data, size_t first, size_t count)
+        : m_data(&data), m_first(first), m_count(count)
+    {
+        if (first > data.size() || count > data.size() - first)
+        {
+            throw std::out_of_range("Dataset view range out of bounds");
+        }
+    }
+
+    // View over an explicit list of dataset indices.
+    DatasetView(const Dataset &data, std::vector<size_t> indices)
+        : m_data(&data), m_first(0), m_count(indices.size()),
+          m_indices(std::make_shared<const std::vector<size_t>>(std::move(indices)))
+    {
+        for (size_t index : *m_indices)
+        {
+            if (index >= data.size())
+            {
+                throw std::out_of_range("Dataset view index out of bounds");
+            }
+        }
+    }
+
+    const Dataset &dataset() const { return *m_data; }
+    size_t size() const { return m_count; }
+    int sampleSize() const { return m_data->sampleSize(); }
+    int numClasses() const { return m_data->numClasses(); }
+
+    // Map a position within the view to an index into the dataset.
+    size_t index(size_t position) const
+    {
+        return m_indices ? (*m_indices)[m_first + position] : m_first + position;
+    }
+
+    const unsigned char *pixels(size_t position) const { return m_data->pixels(index(position)); }
+    int label(size_t position) const { return m_data->label(index(position)); }
+
+    // Sub-range [first, first + count) of this view.
+    DatasetView slice(size_t first, size_t count) const
+    {
+        if (first > m_count || count > m_count - first)
+        {
+            throw std::out_of_range("Dataset view range out of bounds");
+        }
+        DatasetView view(*this);
+        view.m_first = m_first + first;
+        view.m_count = count;
+        return view;
+    }
+
+    // Subset of this view selected by positions within it.
+    DatasetView select(const std::vector<size_t> &positions) const
+    {
+        std::vector<size_t> indices;
+        indices.reserve(positions.size());
+        for (size_t position : positions)
+        {
+            if (position >= m_count)
+            {
+                throw std::out_of_range("Dataset view position out of bounds");
+            }
+            indices.push_back(index(position));
+        }
+        return DatasetView(*m_data, std::move(indices));
+    }
+
+    // Split into k contiguous folds; returns (training, validation) where
+    // validation is the given fold and training is everything else.
+    std::pair<DatasetView, DatasetView> kFold(int k, int fold) const
+    {
+        if (k < 2 || fold < 0 || fold >= k)
+        {
+            throw std::invalid_argument("Invalid k-fold parameters");
+        }
+        size_t begin = m_count * fold / k;
+        size_t end = m_count * (fold + 1) / k;
+
+        std::vector<size_t> positions;
+        positions.reserve(m_count - (end - begin));
+        for (size_t i = 0; i < m_count; i++)
+        {
+            if (i < begin || i >= end)
+            {
+                positions.push_back(i);
+            }
+        }
+        return {select(positions), slice(begin, end - begin)};
+    }
+
+    // Gather rows [first, first + count) of the view, see Dataset::gather.
+    void gatherRange(size_t first, size_t count, double *inputs, double *targets) const
+    {
+        if (!m_indices)
+        {
+            m_data->gatherRange(m_first + first, count, inputs, targets);
+            return;
+        }
+        gatherRows(nullptr, first, count, inputs, targets);
+    }
+
+    // Gather rows at the given view positions, see Dataset::gather.
+    void gather(const size_t *positions, size_t count, double *inputs, double *targets) const
+    {
+        gatherRows(positions, 0, count, inputs, targets);
+    }
+
+private:
+    const Dataset *m_data;
+    size_t m_first;
+    size_t m_count;
+    std::shared_ptr<const std::vector<size_t>> m_indices;
+
+    void gatherRows(const size_t *positions, size_t first, size_t count,
+                    double *inputs, double *targets) const
+    {
+        const int sampleSize = m_data->sampleSize();
+        const int numClasses = m_data->numClasses();
+        for (size_t row = 0; row < count; row++)
+        {
+            size_t position = positions ? positions[row] : first + row;
+            if (position >= m_count)
+            {
+                throw std::out_of_range("Dataset view position out of bounds");
+            }
+            size_t datasetIndex = index(position);
+            m_data->gather(&datasetIndex, 1,
+                           inputs ? inputs + row * sampleSize : nullptr,
+                           targets ? targets + row * numClasses : nullptr);
+        }
+    }
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include "aligned_buffer.h"
+
+// Fully connected layer over a batch of rows, as a matrix product:
+//
+//   outputs[r][j] = biases[j] + sum_k inputs[r][k] * weights[j][k]
+//
+// inputs is rows x inputSize and outputs rows x outputSize, both row-major;
+// panels holds the layer's row-major outputSize x inputSize weight matrix as
+// packed by packWeights. Every sum is accumulated in k order starting from
+// the bias, so each output is bit-identical to a plain dot product over one
+// row, whatever the number of rows.
+void denseBatch(const double *inputs, size_t rows, int inputSize, const double *panels,
+                const double *biases, int outputSize, double *outputs);
+
+// Repack a layer's weights into the panel layout denseBatch multiplies
+// with. The panels only depend on the weights, so they are packed once and
+// reused until the weights change.
+void packWeights(const double *weights, int inputSize, int outputSize, AlignedBuffer<double> &panels);
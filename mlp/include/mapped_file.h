@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "mlp_export.h"
+
+// Read-only file mapped into memory with private copy-on-write pages: the
+// contents can be used in place without copying, and writes (e.g. training
+// a loaded model) go to private pages and never reach the file.
+class MLP_API MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    unsigned char *data() { return m_data; }
+    const unsigned char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    unsigned char *m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#endif
+};
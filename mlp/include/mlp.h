@@ -2,18 +2,123 @@
 
 #include <vector>
 #include <string>
-#include "Perceptron.h"
-
-#ifdef _WIN32
-#ifdef MLP_EXPORT
-#define MLP_API __declspec(dllexport)
-#else
-#define MLP_API __declspec(dllimport)
-#endif
-#else
-#define MLP_API
-#endif
+#include <memory>
+#include "mlp_export.h"
+#include "dataset.h"
+#include "batch_loader.h"
+#include "augmenter.h"
+#include "streaming_loader.h"
+#include "model_format.h"
 
+class TeacherLogits;
+
+// Weight initialization schemes. Xavier (Glorot) is scaled for the sigmoid
+// and softmax layers of this network and He for ReLU-like activations;
+// Uniform is the original initialization in [-1, 1].
+enum class WeightInit
+{
+    Uniform,
+    Xavier,
+    He,
+};
+
+// Settings for MLP::startTraining.
+struct TrainingOptions
+{
+    int epochs = 100;
+    // Early stopping: stop after `patience` epochs without the validation
+    // accuracy improving by more than `minimalImprovement`.
+    int patience = 5;
+    double minimalImprovement = 0.001;
+
+    // Input pipeline.
+    size_t batchSize = 256;
+    bool shuffle = true;
+    uint64_t seed = 0;
+    int prefetchDepth = 3;
+    int loaderThreads = 1;
+    BatchLoader::Augmenter augment;
+
+    // Streaming training only: samples held for window shuffling.
+    size_t shuffleWindow = 65536;
+
+    // Checkpointing. The weights of the best validation epoch are kept in
+    // memory and, if restoreBestWeights is set, put back when training ends.
+    // With a checkpointPath the best weights are also written there, and
+    // every checkpointInterval epochs (0 = never) the current weights and
+    // the training state are written to checkpointPath + ".last", from
+    // which resumeTraining can continue. Files are written on a background
+    // thread.
+    bool restoreBestWeights = true;
+    std::string checkpointPath;
+    int checkpointInterval = 0;
+
+    // Quantization-aware training (0 = off). While training, the network's
+    // forward pass runs as a quantized model does: weights rounded to signed
+    // integers of quantizeWeightBits bits with one scale per output neuron,
+    // and the inputs of every layer to quantizeActivationBits unsigned bits
+    // over [0, 1]. Gradients pass through the rounding unchanged (straight-
+    // through estimator) and update the full-precision weights. Validation,
+    // and with it early stopping and the best weights, sees the quantized
+    // network too. 8 and 7 bits match QuantizedMLP.
+    int quantizeWeightBits = 0;
+    int quantizeActivationBits = 7;
+
+    // Knowledge distillation (null = off). Each sample is trained towards
+    // the teacher's cached outputs, softened by distillationTemperature, with
+    // weight distillationAlpha, and towards its label with weight 1 - alpha.
+    // The soft term is scaled by the squared temperature so that its
+    // gradients keep their size. The teacher's outputs are those of the
+    // samples without augmentation. In-memory training only; the cache must
+    // be built on the dataset of the training view.
+    const TeacherLogits *teacher = nullptr;
+    double distillationTemperature = 4.0;
+    double distillationAlpha = 0.9;
+};
+
+// Which weights MLP::prune ranks against each other by magnitude.
+enum class PruningScope
+{
+    Global,   // all layers together
+    PerLayer, // each layer on its own, to the same sparsity
+};
+
+class MappedFile;
+
+// Read-only view of one dense layer. Weights are row-major, one row of
+// `inputs` values per output neuron.
+struct LayerParameters
+{
+    int inputs;
+    int outputs;
+    const double *weights;
+    const double *biases;
+};
+
+// Scratch memory for inference: the activations of each layer.
+// With a context, forward and forwardBatch allocate nothing once its
+// buffers have grown to size. A context can be used with any model, but
+// only by one call at a time.
+class MLP_API InferenceContext
+{
+public:
+    InferenceContext();
+    ~InferenceContext();
+
+    InferenceContext(const InferenceContext &) = delete;
+    InferenceContext &operator=(const InferenceContext &) = delete;
+
+private:
+    friend class MLP;
+
+    // PIMPL–style internal implementation.
+    struct Buffers;
+    Buffers *m_Buffers;
+};
+
+// Thread safety: inference (forward, forwardBatch, computeAccuracy) is const
+// and reentrant, so one model can serve any number of threads at once.
+// Training, loading and moving the model modify it and need exclusive access.
 class MLP_API MLP
 {
 public:
@@ -23,46 +128,163 @@ public:
      * @param hiddenSizes A vector containing the size of each hidden layer.
      * @param outputSize Number of output neurons.
      * @param learningRate Learning rate for training.
+     * @param init Weight initialization scheme.
+     * @param seed Seed for the initial weights; equal seeds give equal networks.
      */
     MLP(int inputSize, const std::vector<int> &hiddenSizes,
-        int outputSize, double learningRate = 0.1);
+        int outputSize, double learningRate = 0.1,
+        WeightInit init = WeightInit::Xavier, uint64_t seed = 0);
+    ~MLP();
+
+    // Create a network straight from a model file of any supported format.
+    // The topology is read from the file and no weights are initialized
+    // first; float64 files are mapped without copying the weights unless
+    // mapFile is false (see loadModel).
+    static MLP fromFile(const std::string &filename, bool mapFile = true);
+
+    MLP(const MLP &) = delete;
+    MLP &operator=(const MLP &) = delete;
+    MLP(MLP &&other) noexcept;
+    MLP &operator=(MLP &&other) noexcept;
+
+    // Network dimensions.
+    int inputSize() const;
+    int outputSize() const;
+
+    // Parameters of the hidden layers followed by the output layer. The
+    // pointers stay valid until another model is loaded into this object.
+    int numLayers() const;
+    LayerParameters layer(int index) const;
 
-    // Forward pass: returns the network output for given inputs.
-    std::vector<double> forward(const std::vector<double> &inputs);
+    // Forward pass: returns the network output for given inputs. Scratch
+    // memory comes from a context private to the calling thread.
+    std::vector<double> forward(const std::vector<double> &inputs) const;
+    std::vector<double> forward(const double *inputs) const;
+
+    // Forward pass into the context: returns its outputSize() probabilities,
+    // valid until the context is used again.
+    const double *forward(const double *inputs, InferenceContext &context) const;
+
+    // Batched inference over `count` row-major samples of inputSize() values
+    // each. Writes count x outputSize() probabilities, or the predicted class
+    // of every sample, to the caller's buffer. Each layer runs as one matrix
+    // product over the batch, and the results equal those of forward on each
+    // row. Without a context the calling thread's own is used.
+    void forwardBatch(const double *inputs, size_t count, double *probabilities) const;
+    void forwardBatch(const double *inputs, size_t count, int *classes) const;
+    void forwardBatch(const double *inputs, size_t count, double *probabilities,
+                      InferenceContext &context) const;
+    void forwardBatch(const double *inputs, size_t count, int *classes,
+                      InferenceContext &context) const;
 
     // Training with early stopping based on validation accuracy.
-    void startTraining(const std::vector<std::vector<double>> &trainingInputs,
-                       const std::vector<std::vector<double>> &trainingTargets,
-                       const std::vector<std::vector<double>> &validationInputs,
-                       const std::vector<std::vector<double>> &validationTargets,
+    void startTraining(const DatasetView &training, const DatasetView &validation,
                        int epochs, int patience = 5,
                        double minimalImprovement = 0.001);
+    void startTraining(const DatasetView &training, const DatasetView &validation,
+                       const TrainingOptions &options);
+
+    // Training over a sequential sample source with constant memory use.
+    // Each epoch is one pass over the source, shuffled within a window of
+    // options.shuffleWindow samples. Early stopping works as above.
+    void startStreamingTraining(SampleSource &training, const DatasetView &validation,
+                                const TrainingOptions &options);
+
+    // Continue a run from a checkpoint written every checkpointInterval
+    // epochs. Weights, epoch counter, early-stopping state, best weights and
+    // shuffle seed come from the checkpoint, so with the same data and
+    // options the run continues exactly as if it had not been interrupted.
+    void resumeTraining(const std::string &checkpoint, const DatasetView &training,
+                        const DatasetView &validation, const TrainingOptions &options);
+    void resumeStreamingTraining(const std::string &checkpoint, SampleSource &training,
+                                 const DatasetView &validation, const TrainingOptions &options);
+
+    // Magnitude pruning: zero the `sparsity` share (0 to 1) of the weights
+    // with the smallest magnitude; biases are kept. Pruned weights stay zero
+    // in later training, so the network can be fine-tuned with
+    // startTraining, until another model is loaded. Pruning again only adds
+    // to the pruned weights. Returns the number of pruned weights.
+    size_t prune(double sparsity, PruningScope scope = PruningScope::Global);
+
+    // Run a backpropagation step on every row of the batch, in order.
+    // Returns the summed MSE of the outputs after each step and, if
+    // requested, adds the number of correctly classified rows to correct.
+    double trainBatch(const Batch &batch, size_t *correct = nullptr);
 
-    // Save and load the model.
-    void saveModel(const std::string &filename);
-    void loadModel(const std::string &filename);
+    // Save and load the model. Models are saved in the aligned format of
+    // model_format.h; float64 files are memory-mapped by loadModel and used
+    // without copying, narrower scalar types are widened on load. loadModel
+    // also detects and reads the legacy header-less files (single and multiple
+    // hidden layers). Either way the topology and learning rate are taken
+    // from the file. With mapFile = false the weights are copied instead of
+    // mapped, which leaves the file free to be replaced while the model is
+    // in use (Windows does not allow replacing a mapped file).
+    void saveModel(const std::string &filename,
+                   ModelScalarType scalarType = MODEL_SCALAR_FLOAT64) const;
+    void loadModel(const std::string &filename, bool mapFile = true);
 
     // Compute accuracy on a dataset
-    double computeAccuracy(const std::vector<std::vector<double>> &inputs,
-                           const std::vector<std::vector<double>> &targets);
+    double computeAccuracy(const DatasetView &data) const;
 
 private:
     // PIMPL–style internal implementation.
     struct Layers;
     Layers *m_Layers;
 
-    // A backpropagation training step.
-    void train(const std::vector<double> &inputs,
-               const std::vector<double> &targets);
+    // An empty network; only valid once a model has been loaded into it.
+    MLP();
+
+    // Fill every layer according to the scheme. Each value is a function
+    // of (seed, layer, index) only, so large layers are split across threads.
+    void initializeWeights(WeightInit init, uint64_t seed);
+
+    // A backpropagation training step; softTargets are the teacher's
+    // softened outputs when distilling.
+    void train(const double *inputs, const double *targets, const double *softTargets = nullptr);
+
+    // Progress of a training run, as stored in checkpoints.
+    struct TrainingProgress;
+
+    // Epoch loop shared by the in-memory and streaming training modes.
+    void runTraining(BatchProducer &loader, const DatasetView *trainingEval,
+                     const DatasetView &validation, const TrainingOptions &options,
+                     TrainingProgress &progress);
+
+    // Load the weights and training state of a checkpoint.
+    TrainingProgress loadCheckpoint(const std::string &filename);
+
+    // Accuracy and summed MSE over a dataset in one pass.
+    double evaluate(const DatasetView &data, double *totalMSE) const;
+
+    // Compute the output of a layer, given the input.
+    void computeLayerOutput(int layerIndex, const double *inputs, double *outputs,
+                            bool skipActivation = false) const;
+
+    // Raw outputs of one sample straight from the layer weights, without
+    // the packed panels; valid while a training batch is moving the weights.
+    std::vector<double> forwardUnpacked(const double *inputs) const;
+
+    // Complete model file image, as written by saveModel.
+    std::vector<unsigned char> serializeModel(ModelScalarType scalarType) const;
+
+    // Model image followed by the training state, see model_format.h.
+    std::vector<unsigned char> serializeCheckpoint(const TrainingProgress &progress) const;
+
+    // Overwrite the weights with those of a float64 image of the same topology.
+    void restoreModel(const std::vector<unsigned char> &image);
+
+    // Validate a model file image and load its weights. A float64 image
+    // whose mapping is handed over is used in place. Returns the size of
+    // the model part of the image.
+    size_t loadModelImage(const unsigned char *image, size_t size, const std::string &filename,
+                          std::unique_ptr<MappedFile> *mapping);
 
-    // Compute the output of a vector of Perceptron (a layer), given the input.
-    std::vector<double> computeLayerOutput(const std::vector<Perceptron> &layer,
-                                           const std::vector<double> &inputs,
-                                           bool skipActivation = false);
+    // Read a model in the original per-perceptron format.
+    void loadLegacyModel(const std::string &filename);
 
     // Apply softmax to a vector of values
-    std::vector<double> applySoftmax(const std::vector<double> &inputs);
+    static std::vector<double> applySoftmax(const std::vector<double> &inputs);
 
     // Get predicted class (index of maximum value)
-    int getPredictedClass(const std::vector<double> &output);
+    static int getPredictedClass(const std::vector<double> &output);
 };
@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef _WIN32
+#ifdef MLP_EXPORT
+#define MLP_API __declspec(dllexport)
+#else
+#define MLP_API __declspec(dllimport)
+#endif
+#else
+#define MLP_API
+#endif
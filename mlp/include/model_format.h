@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// On-disk model layout (little-endian):
+//
+//   ModelFileHeader
+//   uint32_t layerSizes[numLayers]       outputs of every dense layer, output layer last
+//   zero padding up to dataOffset        a multiple of MODEL_BLOCK_ALIGNMENT
+//   for each layer:
+//     weights[outputs][inputs]           row-major, padded to MODEL_BLOCK_ALIGNMENT
+//     biases[outputs]                    padded to MODEL_BLOCK_ALIGNMENT
+//     scales[outputs]                    int8 files only: float32 per weight row
+//
+// Weights and biases are stored in the file's scalar type, except that int8
+// files keep their biases in float32.
+// Every block starts on a 64-byte boundary relative to the start of the
+// file, so a file mapped at a page boundary can be used in place.
+
+const char MODEL_MAGIC[8] = {'M', 'L', 'P', 'M', 'O', 'D', 'E', 'L'};
+const uint32_t MODEL_VERSION = 1;
+const size_t MODEL_BLOCK_ALIGNMENT = 64;
+
+// Scalar type of the weight and bias blocks.
+// Anything narrower than float64 is widened into owned memory at load time.
+enum ModelScalarType : uint32_t
+{
+    MODEL_SCALAR_FLOAT64 = 1,
+    MODEL_SCALAR_FLOAT32 = 2,
+    MODEL_SCALAR_FLOAT16 = 3,
+    MODEL_SCALAR_BFLOAT16 = 4,
+    MODEL_SCALAR_INT8 = 5, // symmetric, one scale per weight row
+};
+
+// Size in bytes of one stored weight, or 0 for an unknown type.
+inline size_t modelScalarBytes(uint32_t scalarType)
+{
+    switch (scalarType)
+    {
+    case MODEL_SCALAR_FLOAT64:
+        return 8;
+    case MODEL_SCALAR_FLOAT32:
+        return 4;
+    case MODEL_SCALAR_FLOAT16:
+    case MODEL_SCALAR_BFLOAT16:
+        return 2;
+    case MODEL_SCALAR_INT8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+inline const char *modelScalarName(uint32_t scalarType)
+{
+    switch (scalarType)
+    {
+    case MODEL_SCALAR_FLOAT64:
+        return "float64";
+    case MODEL_SCALAR_FLOAT32:
+        return "float32";
+    case MODEL_SCALAR_FLOAT16:
+        return "float16";
+    case MODEL_SCALAR_BFLOAT16:
+        return "bfloat16";
+    case MODEL_SCALAR_INT8:
+        return "int8";
+    default:
+        return "unknown";
+    }
+}
+
+struct ModelFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t scalarType;
+    uint32_t inputSize;
+    uint32_t numLayers;
+    double learningRate;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+static_assert(sizeof(ModelFileHeader) == 48, "ModelFileHeader must be packed to 48 bytes");
+
+inline size_t alignModelBlock(size_t bytes)
+{
+    return (bytes + MODEL_BLOCK_ALIGNMENT - 1) / MODEL_BLOCK_ALIGNMENT * MODEL_BLOCK_ALIGNMENT;
+}
+
+// Byte offsets of each layer's blocks relative to the start of the data section.
+struct ModelLayout
+{
+    std::vector<size_t> weightOffsets;
+    std::vector<size_t> biasOffsets;
+    std::vector<size_t> scaleOffsets; // int8 only
+    size_t dataSize = 0;
+
+    ModelLayout(int inputSize, const std::vector<int> &layerSizes, uint32_t scalarType)
+    {
+        const size_t weightBytes = modelScalarBytes(scalarType);
+        const size_t biasBytes = scalarType == MODEL_SCALAR_INT8 ? sizeof(float) : weightBytes;
+        int previousSize = inputSize;
+        for (int size : layerSizes)
+        {
+            weightOffsets.push_back(dataSize);
+            dataSize += alignModelBlock(static_cast<size_t>(size) * previousSize * weightBytes);
+            biasOffsets.push_back(dataSize);
+            dataSize += alignModelBlock(static_cast<size_t>(size) * biasBytes);
+            if (scalarType == MODEL_SCALAR_INT8)
+            {
+                scaleOffsets.push_back(dataSize);
+                dataSize += alignModelBlock(static_cast<size_t>(size) * sizeof(float));
+            }
+            previousSize = size;
+        }
+    }
+};
+
+// Offset of the data section for a header followed by numLayers sizes.
+inline size_t modelDataOffset(size_t numLayers)
+{
+    return alignModelBlock(sizeof(ModelFileHeader) + numLayers * sizeof(uint32_t));
+}
+
+// Training checkpoints append the state of the run after the model data:
+//
+//   TrainingStateHeader
+//   best model image[bestModelSize]      a complete float64 model file
+//
+// loadModel ignores the extra bytes, so a checkpoint is also a valid model
+// file. Later versions may append further state (e.g. optimizer moments).
+
+const char TRAINING_STATE_MAGIC[8] = {'M', 'L', 'P', 'S', 'T', 'A', 'T', 'E'};
+const uint32_t TRAINING_STATE_VERSION = 1;
+
+struct TrainingStateHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t nextEpoch;
+    int32_t epochsWithoutImprovement;
+    int32_t bestEpoch;
+    double bestAccuracy;
+    double bestModelAccuracy;
+    uint64_t seed;
+    uint64_t bestModelSize;
+};
+static_assert(sizeof(TrainingStateHeader) == 56, "TrainingStateHeader must be packed to 56 bytes");
+
+// Calibrated int8 models (QuantizedMLP::saveCalibrated) append the input
+// range of every layer after the model data:
+//
+//   CalibrationHeader
+//   double ranges[numLayers][2]          low and high of each layer's inputs
+//
+// loadModel ignores it like the training state.
+
+const char CALIBRATION_MAGIC[8] = {'M', 'L', 'P', 'C', 'A', 'L', 'I', 'B'};
+const uint32_t CALIBRATION_VERSION = 1;
+
+struct CalibrationHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numLayers;
+};
+static_assert(sizeof(CalibrationHeader) == 16, "CalibrationHeader must be packed to 16 bytes");
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "mlp_export.h"
+#include "mlp.h"
+
+// Range of the values entering a layer, mapped linearly onto the 7-bit
+// activations; values outside it are clamped. Both ends lie in [0, 1], the
+// range of the network's inputs and of the sigmoid.
+struct ActivationRange
+{
+    double low = 0.0;
+    double high = 1.0;
+};
+
+// Integer inference engine for a trained MLP.
+//
+// Weights are int8 with one scale per output neuron (encodeInt8Row), and
+// activations are unsigned 7-bit integers, 0..127 over the input range of
+// each layer: [0, 1] unless calibrated (see ActivationCalibrator). Each
+// layer accumulates its dot products in int32, rescales them to float, adds
+// the bias, and for hidden layers maps the result through the sigmoid
+// straight to the next layer's 7-bit inputs with a table of thresholds. The
+// output layer ends in softmax or argmax.
+//
+// Activations stop at 127 so that the int16 pair sums of the AVX2 kernel
+// cannot saturate; with that every kernel (AVX-512 VNNI, AVX-VNNI, AVX2,
+// SSE2, portable) gives exactly the same results. The kernel is chosen at
+// compile time from the target's instruction set.
+//
+// Inference is const and reentrant; scratch memory is private to the
+// calling thread.
+class MLP_API QuantizedMLP
+{
+public:
+    /**
+     * Quantize a trained network. The network is not referenced afterwards.
+     * @param mlp Network whose hidden layers use the sigmoid, as trained by MLP.
+     * @param ranges Input range of every layer; empty for [0, 1] throughout.
+     */
+    explicit QuantizedMLP(const MLP &mlp, const std::vector<ActivationRange> &ranges = {});
+    ~QuantizedMLP();
+
+    // Quantize the model in a file of any format MLP::fromFile reads, with
+    // the activation ranges stored by saveCalibrated if it has any.
+    static QuantizedMLP fromFile(const std::string &filename);
+
+    // Write the network as an int8 model file followed by the activation
+    // ranges (see model_format.h). Other readers load it as a plain int8 model.
+    static void saveCalibrated(const MLP &mlp, const std::vector<ActivationRange> &ranges,
+                               const std::string &filename);
+
+    QuantizedMLP(const QuantizedMLP &) = delete;
+    QuantizedMLP &operator=(const QuantizedMLP &) = delete;
+    QuantizedMLP(QuantizedMLP &&other) noexcept;
+    QuantizedMLP &operator=(QuantizedMLP &&other) noexcept;
+
+    int inputSize() const;
+    int outputSize() const;
+    const std::vector<ActivationRange> &ranges() const;
+
+    // Forward pass on inputs in [0, 1], as for MLP::forward; returns the
+    // output probabilities.
+    std::vector<double> forward(const std::vector<double> &inputs) const;
+
+    // Batched inference on raw 8-bit pixels, `count` rows of inputSize()
+    // bytes each, without converting them to double first. Writes
+    // count x outputSize() probabilities or the predicted class of each row.
+    void forwardBatch(const unsigned char *pixels, size_t count, double *probabilities) const;
+    void forwardBatch(const unsigned char *pixels, size_t count, int *classes) const;
+
+    // Memory taken by the quantized weights, scales and biases.
+    size_t parameterBytes() const;
+
+    // Instruction set of the compiled kernel, e.g. "AVX2".
+    static const char *kernelName();
+
+private:
+    // PIMPL–style internal implementation.
+    struct Layers;
+    Layers *m_Layers;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "mlp_export.h"
+#include "mlp.h"
+
+// Inference engine for a pruned MLP (see MLP::prune). Each layer keeps only
+// its non-zero weights in compressed sparse row (CSR) form: per output
+// neuron the column indices and values of its weights, in input order.
+//
+// forwardBatch runs blocks of samples with the activations stored input-
+// major, so each non-zero weight is applied to a whole block at once with
+// vector instructions; leftover rows and forward run one sample at a time.
+// Every output sums its products in input order starting from the bias and
+// only skips zero weights, so the results equal those of the MLP it was
+// built from.
+//
+// Inference is const and reentrant; scratch memory is private to the
+// calling thread.
+class MLP_API SparseMLP
+{
+public:
+    /**
+     * Compress a network. The network is not referenced afterwards.
+     * @param mlp Network whose hidden layers use the sigmoid, as trained by MLP.
+     */
+    explicit SparseMLP(const MLP &mlp);
+    ~SparseMLP();
+
+    // Compress the model in a file of any format MLP::fromFile reads.
+    static SparseMLP fromFile(const std::string &filename);
+
+    SparseMLP(const SparseMLP &) = delete;
+    SparseMLP &operator=(const SparseMLP &) = delete;
+    SparseMLP(SparseMLP &&other) noexcept;
+    SparseMLP &operator=(SparseMLP &&other) noexcept;
+
+    int inputSize() const;
+    int outputSize() const;
+
+    // Forward pass on inputs in [0, 1], as for MLP::forward.
+    std::vector<double> forward(const std::vector<double> &inputs) const;
+
+    // Batched inference over `count` row-major samples, as for MLP::forwardBatch.
+    void forwardBatch(const double *inputs, size_t count, double *probabilities) const;
+    void forwardBatch(const double *inputs, size_t count, int *classes) const;
+
+    // Stored weights, and their share of all weights of the dense network.
+    size_t nonZeros() const;
+    double density() const;
+
+    // Memory taken by the values, indices and biases.
+    size_t parameterBytes() const;
+
+    // Instruction set of the compiled kernel, e.g. "AVX2".
+    static const char *kernelName();
+
+private:
+    // PIMPL–style internal implementation.
+    struct Layers;
+    Layers *m_Layers;
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include "mlp.h"
+
+// Fully connected layer with compile-time dimensions. The weights are kept
+// transposed, one row of Outputs values per input, so the inner loop of the
+// forward pass runs over the outputs with a constant trip count and no
+// reduction; the compiler unrolls and vectorizes it. Every output still sums
+// its products in input order starting from the bias, as MLP does.
+template <int Inputs, int Outputs>
+struct StaticDenseLayer
+{
+    static_assert(Inputs > 0 && Outputs > 0, "Layer sizes must be positive");
+
+    alignas(64) double weights[Inputs][Outputs];
+    alignas(64) double biases[Outputs];
+
+    void forward(const double *in, double *out) const
+    {
+        for (int o = 0; o < Outputs; o++)
+        {
+            out[o] = biases[o];
+        }
+        for (int i = 0; i < Inputs; i++)
+        {
+            const double x = in[i];
+            for (int o = 0; o < Outputs; o++)
+            {
+                out[o] += weights[i][o] * x;
+            }
+        }
+    }
+};
+
+// Inference-only network whose topology is a template argument, e.g.
+// StaticMLP<784, 128, 64, 10> for 784 inputs, hidden layers of 128 and 64
+// sigmoid neurons and 10 softmax outputs. Every loop bound and buffer size
+// is a compile-time constant: the parameters live in one fixed-layout
+// block allocated when the network is loaded, and forward passes use only
+// the stack. Results are bit-identical to MLP::forward on the same weights,
+// unless the compiler is allowed to fuse multiplies and adds (FMA).
+//
+// Inference is const and reentrant.
+template <int... Sizes>
+class StaticMLP
+{
+    static_assert(sizeof...(Sizes) >= 2, "A network needs an input and an output size");
+
+    static constexpr std::array<int, sizeof...(Sizes)> SIZES = {Sizes...};
+
+public:
+    static constexpr int NUM_LAYERS = static_cast<int>(sizeof...(Sizes)) - 1;
+    static constexpr int INPUT_SIZE = SIZES.front();
+    static constexpr int OUTPUT_SIZE = SIZES.back();
+
+    /**
+     * Copy the weights of a network with the same topology.
+     * @param mlp Source network; it is not referenced afterwards.
+     */
+    explicit StaticMLP(const MLP &mlp)
+        : m_Layers(std::make_unique<Layers>())
+    {
+        if (mlp.numLayers() != NUM_LAYERS)
+        {
+            throw std::invalid_argument("Network topology doesn't match the static network");
+        }
+        loadLayers(mlp, std::make_index_sequence<NUM_LAYERS>());
+    }
+
+    // Load a model file of any format MLP::fromFile reads.
+    static StaticMLP fromFile(const std::string &filename)
+    {
+        return StaticMLP(MLP::fromFile(filename));
+    }
+
+    // Softmax probabilities of one sample of INPUT_SIZE values in [0, 1].
+    std::array<double, OUTPUT_SIZE> forward(const double *inputs) const
+    {
+        std::array<double, OUTPUT_SIZE> outputs;
+        forward(inputs, outputs.data());
+        return outputs;
+    }
+
+    void forward(const double *inputs, double *probabilities) const
+    {
+        forwardRaw(inputs, probabilities);
+        softmax(probabilities);
+    }
+
+    // Predicted class; softmax keeps the order, so it is read off the raw outputs.
+    int predict(const double *inputs) const
+    {
+        std::array<double, OUTPUT_SIZE> raw;
+        forwardRaw(inputs, raw.data());
+        return static_cast<int>(std::max_element(raw.begin(), raw.end()) - raw.begin());
+    }
+
+    // `count` row-major samples, as for MLP::forwardBatch.
+    void forwardBatch(const double *inputs, size_t count, double *probabilities) const
+    {
+        for (size_t row = 0; row < count; row++)
+        {
+            forward(inputs + row * INPUT_SIZE, probabilities + row * OUTPUT_SIZE);
+        }
+    }
+
+    void forwardBatch(const double *inputs, size_t count, int *classes) const
+    {
+        for (size_t row = 0; row < count; row++)
+        {
+            classes[row] = predict(inputs + row * INPUT_SIZE);
+        }
+    }
+
+private:
+    template <size_t... I>
+    static std::tuple<StaticDenseLayer<SIZES[I], SIZES[I + 1]>...> layerTypes(std::index_sequence<I...>);
+
+    using Layers = decltype(layerTypes(std::make_index_sequence<NUM_LAYERS>()));
+
+    // Widest layer output, the size of the activation buffers.
+    static constexpr int widestOutput()
+    {
+        int widest = 0;
+        for (size_t i = 1; i < SIZES.size(); i++)
+        {
+            widest = std::max(widest, SIZES[i]);
+        }
+        return widest;
+    }
+
+    std::unique_ptr<Layers> m_Layers;
+
+    template <size_t... I>
+    void loadLayers(const MLP &mlp, std::index_sequence<I...>)
+    {
+        (loadLayer<I>(mlp), ...);
+    }
+
+    template <size_t I>
+    void loadLayer(const MLP &mlp)
+    {
+        constexpr int inputs = SIZES[I];
+        constexpr int outputs = SIZES[I + 1];
+        LayerParameters source = mlp.layer(static_cast<int>(I));
+        if (source.inputs != inputs || source.outputs != outputs)
+        {
+            throw std::invalid_argument("Network topology doesn't match the static network");
+        }
+        auto &layer = std::get<I>(*m_Layers);
+        for (int o = 0; o < outputs; o++)
+        {
+            for (int i = 0; i < inputs; i++)
+            {
+                layer.weights[i][o] = source.weights[static_cast<size_t>(o) * inputs + i];
+            }
+            layer.biases[o] = source.biases[o];
+        }
+    }
+
+    // Raw output-layer values, before softmax.
+    void forwardRaw(const double *inputs, double *raw) const
+    {
+        alignas(64) double activations[2][widestOutput()];
+        forwardLayers(inputs, activations, raw, std::make_index_sequence<NUM_LAYERS>());
+    }
+
+    template <size_t... I>
+    void forwardLayers(const double *inputs, double (&activations)[2][widestOutput()], double *raw,
+                       std::index_sequence<I...>) const
+    {
+        const double *in = inputs;
+        (forwardLayer<I>(in, activations[I % 2], raw), ...);
+    }
+
+    // Run layer I on `in` and advance `in` to its output.
+    template <size_t I>
+    void forwardLayer(const double *&in, double *buffer, double *raw) const
+    {
+        constexpr int outputs = SIZES[I + 1];
+        if constexpr (I + 1 < static_cast<size_t>(NUM_LAYERS))
+        {
+            std::get<I>(*m_Layers).forward(in, buffer);
+            // Sigmoid for the hidden layers only
+            for (int o = 0; o < outputs; o++)
+            {
+                buffer[o] = 1.0 / (1.0 + std::exp(-buffer[o]));
+            }
+            in = buffer;
+        }
+        else
+        {
+            std::get<I>(*m_Layers).forward(in, raw);
+        }
+    }
+
+    // In place, computed as MLP does.
+    static void softmax(double *values)
+    {
+        double maxVal = *std::max_element(values, values + OUTPUT_SIZE);
+        double sum = 0.0;
+        for (int i = 0; i < OUTPUT_SIZE; i++)
+        {
+            values[i] = std::exp(values[i] - maxVal);
+            sum += values[i];
+        }
+        for (int i = 0; i < OUTPUT_SIZE; i++)
+        {
+            values[i] /= sum;
+        }
+    }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "mlp_export.h"
+#include "batch_loader.h"
+
+// A sequential source of raw samples, e.g. a list of CSV or binary shards
+// that is too large to hold in memory. Implementations only need to read
+// forward and start over.
+class SampleSource
+{
+public:
+    virtual ~SampleSource() = default;
+
+    virtual int sampleSize() const = 0;
+    virtual int numClasses() const = 0;
+
+    // Read up to maxCount samples: pixels receives maxCount * sampleSize()
+    // bytes, labels maxCount class indices. Returns the number of samples
+    // read; 0 means the end of the pass has been reached.
+    virtual size_t read(unsigned char *pixels, unsigned char *labels, size_t maxCount) = 0;
+
+    // Start the next pass from the first sample.
+    virtual void rewind() = 0;
+};
+
+// Background loader over a SampleSource with constant memory use. A producer
+// thread reads the source in chunks into a shuffle window of fixed size and
+// emits randomly drawn samples from it, so each epoch is one pass over the
+// source in a locally shuffled order. Batches land in a ring of aligned
+// buffers like BatchLoader's.
+class MLP_API StreamingLoader : public BatchProducer
+{
+public:
+    /**
+     * @param source Sample source; must outlive the loader and is only used on the loader thread.
+     * @param batchSize Maximum number of rows per batch.
+     * @param shuffleWindow Number of samples held for shuffling (1 keeps the source order).
+     * @param seed Seed for the per-epoch draw order.
+     * @param prefetchDepth Number of batch buffers in the ring (at least 2).
+     * @param augment Optional augmentation stage; receives the sample's position in the pass.
+     */
+    StreamingLoader(SampleSource &source, size_t batchSize, size_t shuffleWindow,
+                    uint64_t seed = 0, int prefetchDepth = 3,
+                    BatchLoader::Augmenter augment = nullptr);
+    ~StreamingLoader();
+
+    StreamingLoader(const StreamingLoader &) = delete;
+    StreamingLoader &operator=(const StreamingLoader &) = delete;
+
+    // Rewinds the source. Any batches left over from the previous epoch are discarded.
+    void startEpoch(int epoch) override;
+    bool next(Batch &batch) override;
+
+    double stallSeconds() const override;
+    size_t batchesServed() const override;
+
+private:
+    // PIMPL–style internal implementation.
+    struct Pipeline;
+    Pipeline *m_Pipeline;
+};
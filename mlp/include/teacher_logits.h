@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include "mlp_export.h"
+#include "mlp.h"
+
+// Raw output-layer values (logits) of a teacher network for every sample of
+// a dataset, for knowledge distillation (TrainingOptions::teacher). The
+// teacher runs once when the cache is built, so training a student for any
+// number of epochs, or several students on the same data, costs no further
+// teacher passes. Samples are looked up by their index in the dataset.
+class MLP_API TeacherLogits
+{
+public:
+    /**
+     * Run the teacher over every sample.
+     * @param teacher Network whose outputs the students learn; not referenced afterwards.
+     * @param data Samples to cache; must outlive the cache.
+     */
+    TeacherLogits(const MLP &teacher, const Dataset &data);
+
+    const Dataset &dataset() const;
+    size_t size() const;
+    int numClasses() const;
+
+    // numClasses() logits of the sample at dataset index `index`.
+    const double *logits(size_t index) const;
+
+    // Softmax of the logits divided by temperature; higher temperatures
+    // spread the probability over more classes.
+    void softTargets(size_t index, double temperature, double *probabilities) const;
+
+private:
+    const Dataset *m_data;
+    int m_numClasses;
+    std::vector<double> m_logits;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Conversions between the compute type (double) and the compact scalar types
+// of model files. Encoders round to nearest even; decoders are exact and use
+// SIMD where the target supports it.
+
+void encodeFloat32(const double *values, size_t count, float *out);
+void decodeFloat32(const float *in, size_t count, double *out);
+
+// IEEE 754 binary16.
+void encodeFloat16(const double *values, size_t count, uint16_t *out);
+void decodeFloat16(const uint16_t *in, size_t count, double *out);
+
+// bfloat16: the upper half of a float32.
+void encodeBFloat16(const double *values, size_t count, uint16_t *out);
+void decodeBFloat16(const uint16_t *in, size_t count, double *out);
+
+// Symmetric int8 with one scale for the whole row: value = q * scale.
+// Returns the scale (max |value| / 127, or 0 for an all-zero row).
+float encodeInt8Row(const double *values, size_t count, int8_t *out);
+void decodeInt8Row(const int8_t *in, size_t count, float scale, double *out);
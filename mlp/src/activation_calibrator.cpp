@@ -0,0 +1,274 @@
+#include "../include/activation_calibrator.h"
+#include "../include/aligned_buffer.h"
+#include "../include/dense_kernel.h"
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+// Histogram bins over [0, 1] per layer.
+static const int HISTOGRAM_BINS = 2048;
+
+// Quantization levels of QuantizedMLP's activations (0..127).
+static const int LEVELS = 128;
+
+// Narrowest range returned: one step of the activations over [0, 1].
+static const double MIN_SPAN = 1.0 / (LEVELS - 1);
+
+// Samples run through the network together.
+static const size_t CALIBRATION_BLOCK_ROWS = 256;
+
+struct ActivationCalibrator::Histograms
+{
+    const MLP &mlp;
+    std::vector<std::vector<uint64_t>> counts; // per layer, HISTOGRAM_BINS
+    std::vector<double> minimum;
+    std::vector<double> maximum;
+    size_t samples = 0;
+
+    AlignedBuffer<double> activations[2];
+    std::vector<AlignedBuffer<double>> panels; // per hidden layer
+
+    explicit Histograms(const MLP &network)
+        : mlp(network),
+          counts(network.numLayers(), std::vector<uint64_t>(HISTOGRAM_BINS, 0)),
+          minimum(network.numLayers(), std::numeric_limits<double>::infinity()),
+          maximum(network.numLayers(), -std::numeric_limits<double>::infinity())
+    {
+    }
+
+    void record(int layer, const double *values, size_t count)
+    {
+        std::vector<uint64_t> &histogram = counts[layer];
+        for (size_t i = 0; i < count; i++)
+        {
+            double v = values[i];
+            minimum[layer] = std::min(minimum[layer], v);
+            maximum[layer] = std::max(maximum[layer], v);
+            int bin = static_cast<int>(v * HISTOGRAM_BINS);
+            histogram[std::min(std::max(bin, 0), HISTOGRAM_BINS - 1)]++;
+        }
+    }
+};
+
+ActivationCalibrator::ActivationCalibrator(const MLP &mlp)
+    : m_Histograms(new Histograms(mlp))
+{
+    if (mlp.numLayers() == 0)
+    {
+        delete m_Histograms;
+        throw std::invalid_argument("Cannot calibrate an empty network");
+    }
+}
+
+ActivationCalibrator::~ActivationCalibrator()
+{
+    delete m_Histograms;
+}
+
+size_t ActivationCalibrator::samples() const
+{
+    return m_Histograms->samples;
+}
+
+// Run the hidden layers block by block, recording the inputs of every layer.
+void ActivationCalibrator::observe(const double *inputs, size_t count)
+{
+    Histograms &h = *m_Histograms;
+    const int numLayers = h.mlp.numLayers();
+    size_t width = 0;
+    for (int l = 0; l < numLayers; l++)
+    {
+        width = std::max(width, static_cast<size_t>(h.mlp.layer(l).outputs));
+    }
+    for (AlignedBuffer<double> &buffer : h.activations)
+    {
+        if (buffer.size() < CALIBRATION_BLOCK_ROWS * width)
+        {
+            buffer.resize(CALIBRATION_BLOCK_ROWS * width);
+        }
+    }
+    // Packed once per call, as the network may have changed since the last one.
+    h.panels.resize(numLayers);
+    for (int l = 0; l + 1 < numLayers; l++)
+    {
+        LayerParameters layer = h.mlp.layer(l);
+        packWeights(layer.weights, layer.inputs, layer.outputs, h.panels[l]);
+    }
+
+    const int inputSize = h.mlp.inputSize();
+    for (size_t first = 0; first < count; first += CALIBRATION_BLOCK_ROWS)
+    {
+        const size_t rows = std::min(CALIBRATION_BLOCK_ROWS, count - first);
+        const double *in = inputs + first * inputSize;
+        h.record(0, in, rows * inputSize);
+
+        int current = 0;
+        for (int l = 0; l + 1 < numLayers; l++)
+        {
+            LayerParameters layer = h.mlp.layer(l);
+            double *out = h.activations[current].data();
+            denseBatch(in, rows, layer.inputs, h.panels[l].data(), layer.biases, layer.outputs, out);
+            for (size_t i = 0; i < rows * layer.outputs; i++)
+            {
+                out[i] = 1.0 / (1.0 + std::exp(-out[i]));
+            }
+            h.record(l + 1, out, rows * layer.outputs);
+            in = out;
+            current = 1 - current;
+        }
+    }
+    h.samples += count;
+}
+
+void ActivationCalibrator::observe(const DatasetView &data)
+{
+    const int inputSize = data.sampleSize();
+    if (inputSize != m_Histograms->mlp.inputSize())
+    {
+        throw std::invalid_argument("Calibration data does not match the network");
+    }
+    std::vector<double> inputs(CALIBRATION_BLOCK_ROWS * inputSize);
+    for (size_t first = 0; first < data.size(); first += CALIBRATION_BLOCK_ROWS)
+    {
+        size_t count = std::min(CALIBRATION_BLOCK_ROWS, data.size() - first);
+        data.gatherRange(first, count, inputs.data(), nullptr);
+        observe(inputs.data(), count);
+    }
+}
+
+std::vector<ActivationRange> ActivationCalibrator::observedRanges() const
+{
+    const Histograms &h = *m_Histograms;
+    if (h.samples == 0)
+    {
+        throw std::runtime_error("No calibration samples observed");
+    }
+    std::vector<ActivationRange> ranges(h.counts.size());
+    for (size_t l = 0; l < ranges.size(); l++)
+    {
+        ranges[l].low = h.minimum[l];
+        ranges[l].high = h.maximum[l];
+    }
+    return ranges;
+}
+
+// Bins [first, end) of the histogram are quantized to LEVELS levels, with
+// everything at or above end clipped into the last bin. Returns the KL
+// divergence of the quantized from the clipped distribution.
+static double quantizationDivergence(const std::vector<uint64_t> &histogram, int first, int end)
+{
+    const int bins = end - first;
+    std::vector<double> reference(histogram.begin() + first, histogram.begin() + end);
+    for (int b = end; b < HISTOGRAM_BINS; b++)
+    {
+        reference.back() += static_cast<double>(histogram[b]);
+    }
+
+    // Each level spreads its count evenly over its non-empty bins.
+    std::vector<double> quantized(bins, 0.0);
+    for (int level = 0; level < LEVELS; level++)
+    {
+        int begin = level * bins / LEVELS;
+        int stop = (level + 1) * bins / LEVELS;
+        double total = 0.0;
+        int nonEmpty = 0;
+        for (int b = begin; b < stop; b++)
+        {
+            total += static_cast<double>(histogram[first + b]);
+            nonEmpty += histogram[first + b] != 0;
+        }
+        for (int b = begin; b < stop; b++)
+        {
+            quantized[b] = histogram[first + b] != 0 ? total / nonEmpty : 0.0;
+        }
+    }
+
+    double referenceTotal = 0.0;
+    double quantizedTotal = 0.0;
+    for (int b = 0; b < bins; b++)
+    {
+        referenceTotal += reference[b];
+        quantizedTotal += quantized[b];
+    }
+    double divergence = 0.0;
+    for (int b = 0; b < bins; b++)
+    {
+        if (reference[b] > 0.0)
+        {
+            double p = reference[b] / referenceTotal;
+            // The clipped mass in the last bin may have no counterpart.
+            double q = std::max(quantized[b] / quantizedTotal, 1e-12);
+            divergence += p * std::log(p / q);
+        }
+    }
+    return divergence;
+}
+
+std::vector<ActivationRange> ActivationCalibrator::ranges(CalibrationMethod method, double percentile) const
+{
+    if (method == CalibrationMethod::Percentile && !(percentile > 50.0 && percentile <= 100.0))
+    {
+        throw std::invalid_argument("Percentile must be in (50, 100]");
+    }
+    std::vector<ActivationRange> ranges = observedRanges();
+    const Histograms &h = *m_Histograms;
+    for (size_t l = 0; l < ranges.size() && method != CalibrationMethod::MinMax; l++)
+    {
+        const std::vector<uint64_t> &histogram = h.counts[l];
+        uint64_t total = 0;
+        for (uint64_t count : histogram)
+        {
+            total += count;
+        }
+        const int minBin = std::min(static_cast<int>(ranges[l].low * HISTOGRAM_BINS), HISTOGRAM_BINS - 1);
+
+        if (method == CalibrationMethod::Percentile)
+        {
+            const double clipped = (100.0 - percentile) / 100.0 * static_cast<double>(total);
+            int low = 0;
+            for (uint64_t below = 0; low < HISTOGRAM_BINS - 1 && below + histogram[low] <= clipped; low++)
+            {
+                below += histogram[low];
+            }
+            int high = HISTOGRAM_BINS - 1;
+            for (uint64_t above = 0; high > 0 && above + histogram[high] <= clipped; high--)
+            {
+                above += histogram[high];
+            }
+            ranges[l].low = std::max(ranges[l].low, static_cast<double>(low) / HISTOGRAM_BINS);
+            ranges[l].high = std::min(ranges[l].high, static_cast<double>(high + 1) / HISTOGRAM_BINS);
+        }
+        else if (HISTOGRAM_BINS - minBin > LEVELS)
+        {
+            // The lower end stays at the minimum; the upper end is searched.
+            int bestEnd = HISTOGRAM_BINS;
+            double bestDivergence = std::numeric_limits<double>::infinity();
+            for (int end = minBin + LEVELS; end <= HISTOGRAM_BINS; end++)
+            {
+                double divergence = quantizationDivergence(histogram, minBin, end);
+                if (divergence < bestDivergence)
+                {
+                    bestDivergence = divergence;
+                    bestEnd = end;
+                }
+            }
+            ranges[l].high = std::min(ranges[l].high, static_cast<double>(bestEnd) / HISTOGRAM_BINS);
+        }
+    }
+
+    // A layer whose inputs barely vary still gets a usable range.
+    for (ActivationRange &range : ranges)
+    {
+        range.low = std::max(range.low, 0.0);
+        range.high = std::min(range.high, 1.0);
+        if (range.high - range.low < MIN_SPAN)
+        {
+            double centre = std::min(std::max((range.low + range.high) / 2.0, MIN_SPAN / 2.0), 1.0 - MIN_SPAN / 2.0);
+            range.low = centre - MIN_SPAN / 2.0;
+            range.high = centre + MIN_SPAN / 2.0;
+        }
+    }
+    return ranges;
+}
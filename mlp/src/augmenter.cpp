@@ -0,0 +1,233 @@
+#include "../include/augmenter.h"
+#include "../include/counter_rng.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MLP_AUGMENT_SSE2
+#endif
+
+// Source images are copied into a float buffer with a zero border of PAD
+// pixels. Sample coordinates are clamped to [-1, size], so after adding
+// PAD both bilinear neighbours are always inside the buffer and the
+// sampling loop needs no bounds checks.
+static const int PAD = 2;
+
+// Bilinear sample of `count` points (sx[i], sy[i]) from the padded image,
+// rounding the result to uint8.
+static void bilinearSample(const float *padded, int stride, int width, int height,
+                           const float *sx, const float *sy, int count,
+                           unsigned char *out)
+{
+    const float maxX = static_cast<float>(width);
+    const float maxY = static_cast<float>(height);
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+    const __m256 hiX = _mm256_set1_ps(maxX);
+    const __m256 hiY = _mm256_set1_ps(maxY);
+    const __m256 pad = _mm256_set1_ps(static_cast<float>(PAD));
+    const __m256i strideV = _mm256_set1_epi32(stride);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 maxPixel = _mm256_set1_ps(255.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(sx + i), lo), hiX), pad);
+        __m256 y = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(sy + i), lo), hiY), pad);
+        __m256i ix = _mm256_cvttps_epi32(x);
+        __m256i iy = _mm256_cvttps_epi32(y);
+        __m256 fx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix));
+        __m256 fy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy));
+
+        __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(iy, strideV), ix);
+        __m256i idxBelow = _mm256_add_epi32(idx, strideV);
+        __m256 p00 = _mm256_i32gather_ps(padded, idx, 4);
+        __m256 p01 = _mm256_i32gather_ps(padded, _mm256_add_epi32(idx, one), 4);
+        __m256 p10 = _mm256_i32gather_ps(padded, idxBelow, 4);
+        __m256 p11 = _mm256_i32gather_ps(padded, _mm256_add_epi32(idxBelow, one), 4);
+
+        __m256 top = _mm256_add_ps(p00, _mm256_mul_ps(fx, _mm256_sub_ps(p01, p00)));
+        __m256 bottom = _mm256_add_ps(p10, _mm256_mul_ps(fx, _mm256_sub_ps(p11, p10)));
+        __m256 v = _mm256_add_ps(top, _mm256_mul_ps(fy, _mm256_sub_ps(bottom, top)));
+        v = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(v, half), zero), maxPixel);
+
+        alignas(32) int values[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(values), _mm256_cvttps_epi32(v));
+        for (int k = 0; k < 8; k++)
+        {
+            out[i + k] = static_cast<unsigned char>(values[k]);
+        }
+    }
+#elif defined(MLP_AUGMENT_SSE2)
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hiX = _mm_set1_ps(maxX);
+    const __m128 hiY = _mm_set1_ps(maxY);
+    const __m128 pad = _mm_set1_ps(static_cast<float>(PAD));
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 maxPixel = _mm_set1_ps(255.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(sx + i), lo), hiX), pad);
+        __m128 y = _mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(sy + i), lo), hiY), pad);
+        __m128i ix = _mm_cvttps_epi32(x);
+        __m128i iy = _mm_cvttps_epi32(y);
+        __m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix));
+        __m128 fy = _mm_sub_ps(y, _mm_cvtepi32_ps(iy));
+
+        // SSE2 has no gather; fetch the four neighbours of each lane by hand.
+        alignas(16) int xs[4];
+        alignas(16) int ys[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(xs), ix);
+        _mm_store_si128(reinterpret_cast<__m128i *>(ys), iy);
+        alignas(16) float n00[4], n01[4], n10[4], n11[4];
+        for (int k = 0; k < 4; k++)
+        {
+            const float *p = padded + ys[k] * stride + xs[k];
+            n00[k] = p[0];
+            n01[k] = p[1];
+            n10[k] = p[stride];
+            n11[k] = p[stride + 1];
+        }
+        __m128 p00 = _mm_load_ps(n00);
+        __m128 p01 = _mm_load_ps(n01);
+        __m128 p10 = _mm_load_ps(n10);
+        __m128 p11 = _mm_load_ps(n11);
+
+        __m128 top = _mm_add_ps(p00, _mm_mul_ps(fx, _mm_sub_ps(p01, p00)));
+        __m128 bottom = _mm_add_ps(p10, _mm_mul_ps(fx, _mm_sub_ps(p11, p10)));
+        __m128 v = _mm_add_ps(top, _mm_mul_ps(fy, _mm_sub_ps(bottom, top)));
+        v = _mm_min_ps(_mm_max_ps(_mm_add_ps(v, half), zero), maxPixel);
+
+        alignas(16) int values[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(values), _mm_cvttps_epi32(v));
+        for (int k = 0; k < 4; k++)
+        {
+            out[i + k] = static_cast<unsigned char>(values[k]);
+        }
+    }
+#endif
+
+    // Scalar tail (and portable fallback), same arithmetic as the vector paths.
+    for (; i < count; i++)
+    {
+        float x = std::min(std::max(sx[i], -1.0f), maxX) + PAD;
+        float y = std::min(std::max(sy[i], -1.0f), maxY) + PAD;
+        int ix = static_cast<int>(x);
+        int iy = static_cast<int>(y);
+        float fx = x - static_cast<float>(ix);
+        float fy = y - static_cast<float>(iy);
+        const float *p = padded + iy * stride + ix;
+        float top = p[0] + fx * (p[1] - p[0]);
+        float bottom = p[stride] + fx * (p[stride + 1] - p[stride]);
+        float v = std::min(std::max(top + fy * (bottom - top) + 0.5f, 0.0f), 255.0f);
+        out[i] = static_cast<unsigned char>(static_cast<int>(v));
+    }
+}
+
+ImageAugmenter::ImageAugmenter(int width, int height, const AugmentationOptions &options)
+    : m_width(width), m_height(height), m_options(options)
+{
+    if (width < 2 || height < 2 || options.minScale <= 0.0 || options.maxScale < options.minScale ||
+        options.elasticGrid == 1 || options.elasticGrid < 0)
+    {
+        throw std::invalid_argument("Invalid augmentation configuration");
+    }
+}
+
+void ImageAugmenter::apply(unsigned char *pixels, size_t sampleIndex, int epoch) const
+{
+    const int width = m_width;
+    const int height = m_height;
+    const int stride = width + 2 * PAD;
+    const int count = width * height;
+
+    // Per-thread scratch; apply() itself keeps no state between calls.
+    thread_local std::vector<float> padded;
+    thread_local std::vector<float> sx;
+    thread_local std::vector<float> sy;
+    thread_local std::vector<float> grid;
+    padded.assign(static_cast<size_t>(stride) * (height + 2 * PAD), 0.0f);
+    sx.resize(count);
+    sy.resize(count);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            padded[(y + PAD) * stride + x + PAD] = pixels[y * width + x];
+        }
+    }
+
+    // Random parameters are a pure function of (seed, epoch, sample).
+    CounterRng rng(m_options.seed + static_cast<uint64_t>(epoch) * 0x9E3779B97F4A7C15ULL, sampleIndex);
+    const double pi = 3.14159265358979323846;
+    double angle = rng.uniform(-m_options.maxRotationDegrees, m_options.maxRotationDegrees) * pi / 180.0;
+    double scale = rng.uniform(m_options.minScale, m_options.maxScale);
+    double shiftX = rng.uniform(-m_options.maxShift, m_options.maxShift);
+    double shiftY = rng.uniform(-m_options.maxShift, m_options.maxShift);
+
+    // Inverse mapping from each output pixel back into the source image.
+    const float cosA = static_cast<float>(std::cos(angle) / scale);
+    const float sinA = static_cast<float>(std::sin(angle) / scale);
+    const float cx = (width - 1) * 0.5f;
+    const float cy = (height - 1) * 0.5f;
+    const float offX = cx - static_cast<float>(shiftX);
+    const float offY = cy - static_cast<float>(shiftY);
+    for (int y = 0; y < height; y++)
+    {
+        const float dy = y - cy;
+        float *rowX = sx.data() + y * width;
+        float *rowY = sy.data() + y * width;
+        for (int x = 0; x < width; x++)
+        {
+            const float dx = x - cx;
+            rowX[x] = cosA * dx + sinA * dy + offX;
+            rowY[x] = -sinA * dx + cosA * dy + offY;
+        }
+    }
+
+    // Elastic distortion: random displacements on a coarse grid of control
+    // points, bilinearly interpolated into a smooth field over the image.
+    const int g = m_options.elasticGrid;
+    if (g > 0 && m_options.elasticAlpha > 0.0)
+    {
+        grid.resize(2 * g * g);
+        for (float &d : grid)
+        {
+            d = static_cast<float>(rng.normal() * m_options.elasticAlpha);
+        }
+        const float toGridX = static_cast<float>(g - 1) / (width - 1);
+        const float toGridY = static_cast<float>(g - 1) / (height - 1);
+        for (int y = 0; y < height; y++)
+        {
+            float gy = y * toGridY;
+            int y0 = std::min(static_cast<int>(gy), g - 2);
+            float ty = gy - y0;
+            for (int x = 0; x < width; x++)
+            {
+                float gx = x * toGridX;
+                int x0 = std::min(static_cast<int>(gx), g - 2);
+                float tx = gx - x0;
+                for (int axis = 0; axis < 2; axis++)
+                {
+                    const float *c = grid.data() + axis * g * g + y0 * g + x0;
+                    float top = c[0] + tx * (c[1] - c[0]);
+                    float bottom = c[g] + tx * (c[g + 1] - c[g]);
+                    float d = top + ty * (bottom - top);
+                    (axis == 0 ? sx : sy)[y * width + x] += d;
+                }
+            }
+        }
+    }
+
+    bilinearSample(padded.data(), stride, width, height, sx.data(), sy.data(), count, pixels);
+}
@@ -0,0 +1,286 @@
+#include "../include/batch_loader.h"
+#include "../include/aligned_buffer.h"
+#include "../include/counter_rng.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+// One entry of the prefetch ring.
+struct LoaderSlot
+{
+    AlignedBuffer<double> inputs;
+    AlignedBuffer<double> targets;
+    std::vector<size_t> indices;
+    size_t count = 0;
+    bool ready = false;
+};
+
+// Batch b of an epoch always lands in slot b % depth. A worker may start on
+// batch b only once the consumer has released batch b - depth, so a slot is
+// never overwritten while the trainer still reads it.
+struct BatchLoader::Pipeline
+{
+    DatasetView data;
+    size_t batchSize;
+    bool shuffle;
+    uint64_t seed;
+    Augmenter augment;
+
+    std::vector<size_t> order; // epoch order as positions within the view
+    std::vector<LoaderSlot> slots;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable batchReady;
+    std::condition_variable fillDone;
+
+    int epoch = 0;
+    unsigned long long generation = 0;
+    size_t numBatches = 0;
+    size_t nextToFill = 0;
+    size_t nextToServe = 0;
+    size_t released = 0;
+    bool holding = false;
+    int activeFills = 0;
+    bool stopping = false;
+    std::exception_ptr error; // first failed fill of the epoch, rethrown by next()
+
+    double stallSeconds = 0.0;
+    size_t batchesServed = 0;
+
+    Pipeline(const DatasetView &view) : data(view) {}
+
+    void workerLoop();
+    void fill(LoaderSlot &slot, size_t batchIndex, int batchEpoch,
+              std::vector<unsigned char> &scratch);
+};
+
+void BatchLoader::Pipeline::workerLoop()
+{
+    std::vector<unsigned char> scratch(data.sampleSize());
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        workAvailable.wait(lock, [this]
+                           { return stopping ||
+                                    (nextToFill < numBatches && nextToFill < released + slots.size()); });
+        if (stopping)
+        {
+            return;
+        }
+
+        size_t batchIndex = nextToFill++;
+        unsigned long long fillGeneration = generation;
+        int fillEpoch = epoch;
+        LoaderSlot &slot = slots[batchIndex % slots.size()];
+        activeFills++;
+
+        lock.unlock();
+        std::exception_ptr failure;
+        try
+        {
+            fill(slot, batchIndex, fillEpoch, scratch);
+        }
+        catch (...)
+        {
+            // An exception must not escape the thread; the trainer gets it.
+            failure = std::current_exception();
+        }
+        lock.lock();
+
+        activeFills--;
+        if (fillGeneration == generation)
+        {
+            if (failure)
+            {
+                error = error ? error : failure;
+            }
+            else
+            {
+                slot.ready = true;
+            }
+            batchReady.notify_all();
+        }
+        fillDone.notify_all();
+    }
+}
+
+void BatchLoader::Pipeline::fill(LoaderSlot &slot, size_t batchIndex, int batchEpoch,
+                                 std::vector<unsigned char> &scratch)
+{
+    const int sampleSize = data.sampleSize();
+    const int numClasses = data.numClasses();
+    size_t first = batchIndex * batchSize;
+    slot.count = std::min(batchSize, data.size() - first);
+
+    double *inputs = slot.inputs.data();
+    double *targets = slot.targets.data();
+    std::fill(targets, targets + slot.count * numClasses, 0.0);
+    for (size_t row = 0; row < slot.count; row++)
+    {
+        size_t position = shuffle ? order[first + row] : first + row;
+        size_t datasetIndex = data.index(position);
+        slot.indices[row] = datasetIndex;
+        const unsigned char *pixels = data.dataset().pixels(datasetIndex);
+        if (augment)
+        {
+            std::copy(pixels, pixels + sampleSize, scratch.begin());
+            augment(scratch.data(), datasetIndex, batchEpoch);
+            pixels = scratch.data();
+        }
+        Dataset::normalize(pixels, sampleSize, inputs + row * sampleSize);
+        targets[row * numClasses + data.dataset().label(datasetIndex)] = 1.0;
+    }
+}
+
+BatchLoader::BatchLoader(const DatasetView &data, size_t batchSize, bool shuffle,
+                         uint64_t seed, int prefetchDepth, int workers,
+                         Augmenter augment)
+    : m_Pipeline(new Pipeline(data))
+{
+    if (batchSize == 0 || prefetchDepth < 2 || workers < 1)
+    {
+        delete m_Pipeline;
+        throw std::invalid_argument("Invalid batch loader configuration");
+    }
+    m_Pipeline->batchSize = batchSize;
+    m_Pipeline->shuffle = shuffle;
+    m_Pipeline->seed = seed;
+    m_Pipeline->augment = augment;
+
+    m_Pipeline->slots.resize(prefetchDepth);
+    for (LoaderSlot &slot : m_Pipeline->slots)
+    {
+        slot.inputs.resize(batchSize * data.sampleSize());
+        slot.targets.resize(batchSize * data.numClasses());
+        slot.indices.resize(batchSize);
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        m_Pipeline->workers.emplace_back([this]
+                                         { m_Pipeline->workerLoop(); });
+    }
+}
+
+BatchLoader::~BatchLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Pipeline->mutex);
+        m_Pipeline->stopping = true;
+    }
+    m_Pipeline->workAvailable.notify_all();
+    for (std::thread &worker : m_Pipeline->workers)
+    {
+        worker.join();
+    }
+    delete m_Pipeline;
+}
+
+void BatchLoader::startEpoch(int epoch)
+{
+    Pipeline &p = *m_Pipeline;
+    std::unique_lock<std::mutex> lock(p.mutex);
+
+    // Invalidate in-flight fills of the previous epoch and let them drain.
+    p.generation++;
+    p.numBatches = 0;
+    p.fillDone.wait(lock, [&p]
+                    { return p.activeFills == 0; });
+
+    if (p.shuffle)
+    {
+        // Fisher-Yates driven by a counter-based RNG keyed on (seed, epoch),
+        // so the order of any epoch can be reproduced on its own.
+        p.order.resize(p.data.size());
+        for (size_t i = 0; i < p.order.size(); i++)
+        {
+            p.order[i] = i;
+        }
+        CounterRng rng(p.seed, static_cast<uint64_t>(epoch));
+        for (size_t i = p.order.size(); i > 1; i--)
+        {
+            std::swap(p.order[i - 1], p.order[rng.below(i)]);
+        }
+    }
+
+    for (LoaderSlot &slot : p.slots)
+    {
+        slot.ready = false;
+    }
+    p.error = nullptr;
+    p.epoch = epoch;
+    p.nextToFill = 0;
+    p.nextToServe = 0;
+    p.released = 0;
+    p.holding = false;
+    p.numBatches = (p.data.size() + p.batchSize - 1) / p.batchSize;
+    p.workAvailable.notify_all();
+}
+
+bool BatchLoader::next(Batch &batch)
+{
+    Pipeline &p = *m_Pipeline;
+    std::unique_lock<std::mutex> lock(p.mutex);
+
+    // The previously served batch is no longer in use; its slot can be refilled.
+    if (p.holding)
+    {
+        p.holding = false;
+        p.released++;
+        p.workAvailable.notify_all();
+    }
+    if (p.nextToServe >= p.numBatches)
+    {
+        return false;
+    }
+
+    LoaderSlot &slot = p.slots[p.nextToServe % p.slots.size()];
+    if (!slot.ready && !p.error)
+    {
+        auto waitStart = std::chrono::steady_clock::now();
+        p.batchReady.wait(lock, [&]
+                          { return slot.ready || p.error; });
+        p.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+    }
+    // A failed fill ends the epoch; startEpoch clears the error.
+    if (p.error)
+    {
+        std::rethrow_exception(p.error);
+    }
+    slot.ready = false;
+
+    batch.inputs = slot.inputs.data();
+    batch.targets = slot.targets.data();
+    batch.indices = slot.indices.data();
+    batch.count = slot.count;
+    batch.inputSize = p.data.sampleSize();
+    batch.outputSize = p.data.numClasses();
+
+    p.nextToServe++;
+    p.holding = true;
+    p.batchesServed++;
+    return true;
+}
+
+size_t BatchLoader::batchesPerEpoch() const
+{
+    return (m_Pipeline->data.size() + m_Pipeline->batchSize - 1) / m_Pipeline->batchSize;
+}
+
+double BatchLoader::stallSeconds() const
+{
+    std::lock_guard<std::mutex> lock(m_Pipeline->mutex);
+    return m_Pipeline->stallSeconds;
+}
+
+size_t BatchLoader::batchesServed() const
+{
+    std::lock_guard<std::mutex> lock(m_Pipeline->mutex);
+    return m_Pipeline->batchesServed;
+}
@@ -0,0 +1,135 @@
+#include "../include/checkpoint_writer.h"
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+struct CheckpointWriter::Worker
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable idle;
+
+    // Pending images in submission order, at most one per path.
+    std::vector<std::pair<std::string, Image>> pending;
+    bool writing = false;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    void run();
+};
+
+static void writeFile(const std::string &path, const std::vector<unsigned char> &image)
+{
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream ofs(temporary, std::ios::binary | std::ios::trunc);
+        if (!ofs)
+        {
+            throw std::runtime_error("Unable to open file for saving: " + temporary);
+        }
+        ofs.write(reinterpret_cast<const char *>(image.data()), image.size());
+        ofs.close();
+        if (!ofs)
+        {
+            throw std::runtime_error("Failed to write checkpoint: " + temporary);
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec)
+    {
+        throw std::runtime_error("Failed to replace checkpoint " + path + ": " + ec.message());
+    }
+}
+
+void CheckpointWriter::Worker::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        workAvailable.wait(lock, [this]
+                           { return stopping || !pending.empty(); });
+        if (pending.empty())
+        {
+            return;
+        }
+        std::pair<std::string, Image> job = std::move(pending.front());
+        pending.erase(pending.begin());
+        writing = true;
+
+        lock.unlock();
+        std::exception_ptr failure;
+        try
+        {
+            writeFile(job.first, *job.second);
+        }
+        catch (...)
+        {
+            failure = std::current_exception();
+        }
+        lock.lock();
+
+        writing = false;
+        if (failure && !error)
+        {
+            error = failure;
+        }
+        idle.notify_all();
+    }
+}
+
+CheckpointWriter::CheckpointWriter()
+    : m_Worker(new Worker())
+{
+    m_Worker->thread = std::thread([this]
+                                   { m_Worker->run(); });
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Worker->mutex);
+        m_Worker->stopping = true;
+    }
+    m_Worker->workAvailable.notify_all();
+    m_Worker->thread.join();
+    delete m_Worker;
+}
+
+void CheckpointWriter::submit(const std::string &path, Image image)
+{
+    if (!image)
+    {
+        throw std::invalid_argument("Checkpoint image is empty");
+    }
+    std::lock_guard<std::mutex> lock(m_Worker->mutex);
+    for (auto &job : m_Worker->pending)
+    {
+        if (job.first == path)
+        {
+            job.second = std::move(image);
+            return;
+        }
+    }
+    m_Worker->pending.emplace_back(path, std::move(image));
+    m_Worker->workAvailable.notify_one();
+}
+
+void CheckpointWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(m_Worker->mutex);
+    m_Worker->idle.wait(lock, [this]
+                        { return m_Worker->pending.empty() && !m_Worker->writing; });
+    if (m_Worker->error)
+    {
+        std::exception_ptr error = m_Worker->error;
+        m_Worker->error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,146 @@
+#include "../include/dataset.h"
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+// Pixels are kept as raw bytes and labels as integers; conversion to the
+// network's scalar type happens only when a batch is gathered.
+struct Dataset::Storage
+{
+    int sampleSize;
+    int numClasses;
+    std::vector<unsigned char> pixels;
+    std::vector<unsigned char> labels;
+};
+
+Dataset::Dataset(int sampleSize, int numClasses)
+    : m_Storage(new Storage())
+{
+    if (sampleSize <= 0 || numClasses <= 0 || numClasses > 256)
+    {
+        throw std::invalid_argument("Invalid dataset dimensions");
+    }
+    m_Storage->sampleSize = sampleSize;
+    m_Storage->numClasses = numClasses;
+}
+
+Dataset::~Dataset()
+{
+    delete m_Storage;
+}
+
+Dataset::Dataset(Dataset &&other) noexcept
+    : m_Storage(other.m_Storage)
+{
+    other.m_Storage = nullptr;
+}
+
+Dataset &Dataset::operator=(Dataset &&other) noexcept
+{
+    if (this != &other)
+    {
+        delete m_Storage;
+        m_Storage = other.m_Storage;
+        other.m_Storage = nullptr;
+    }
+    return *this;
+}
+
+void Dataset::reserve(size_t count)
+{
+    m_Storage->pixels.reserve(count * m_Storage->sampleSize);
+    m_Storage->labels.reserve(count);
+}
+
+void Dataset::addSample(const unsigned char *pixels, int label)
+{
+    if (label < 0 || label >= m_Storage->numClasses)
+    {
+        throw std::runtime_error("Label out of range for dataset.");
+    }
+    m_Storage->pixels.insert(m_Storage->pixels.end(), pixels, pixels + m_Storage->sampleSize);
+    m_Storage->labels.push_back(static_cast<unsigned char>(label));
+}
+
+size_t Dataset::size() const
+{
+    return m_Storage->labels.size();
+}
+
+int Dataset::sampleSize() const
+{
+    return m_Storage->sampleSize;
+}
+
+int Dataset::numClasses() const
+{
+    return m_Storage->numClasses;
+}
+
+const unsigned char *Dataset::pixels(size_t index) const
+{
+    return m_Storage->pixels.data() + index * m_Storage->sampleSize;
+}
+
+int Dataset::label(size_t index) const
+{
+    return m_Storage->labels[index];
+}
+
+void Dataset::normalize(const unsigned char *pixels, size_t count, double *out)
+{
+    const double scale = 1.0 / 255.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = pixels[i] * scale;
+    }
+}
+
+void Dataset::gather(const size_t *indices, size_t count,
+                     double *inputs, double *targets) const
+{
+    const int sampleSize = m_Storage->sampleSize;
+    const int numClasses = m_Storage->numClasses;
+    for (size_t row = 0; row < count; row++)
+    {
+        size_t index = indices[row];
+        if (index >= size())
+        {
+            throw std::out_of_range("Dataset index out of range");
+        }
+        if (inputs)
+        {
+            normalize(pixels(index), sampleSize, inputs + row * sampleSize);
+        }
+        if (targets)
+        {
+            double *target = targets + row * numClasses;
+            std::fill(target, target + numClasses, 0.0);
+            target[m_Storage->labels[index]] = 1.0;
+        }
+    }
+}
+
+void Dataset::gatherRange(size_t first, size_t count,
+                          double *inputs, double *targets) const
+{
+    if (first > size() || count > size() - first)
+    {
+        throw std::out_of_range("Dataset range out of range");
+    }
+    const int sampleSize = m_Storage->sampleSize;
+    const int numClasses = m_Storage->numClasses;
+    if (inputs)
+    {
+        // Contiguous rows can be normalized in a single pass.
+        normalize(pixels(first), count * sampleSize, inputs);
+    }
+    if (targets)
+    {
+        std::fill(targets, targets + count * numClasses, 0.0);
+        for (size_t row = 0; row < count; row++)
+        {
+            targets[row * numClasses + m_Storage->labels[first + row]] = 1.0;
+        }
+    }
+}
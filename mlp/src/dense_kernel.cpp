@@ -0,0 +1,173 @@
+#include "../include/dense_kernel.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MLP_GEMM_SSE2
+#endif
+
+// packWeights lays the weights out in panels of PANEL output columns stored
+// k-major, PANEL consecutive values per input, so the micro-kernel reads a
+// panel with aligned vector loads and broadcasts one input per row.
+static const int PANEL = 8;
+static const int MICRO_ROWS = 4;
+
+// Cache blocking: a block of ROW_BLOCK x DEPTH_BLOCK inputs stays in L2
+// while it is multiplied with every panel, and the DEPTH_BLOCK x PANEL
+// slice of a panel stays in L1 while it is used for all rows of the block.
+static const size_t ROW_BLOCK = 64;
+static const int DEPTH_BLOCK = 256;
+
+// Add `depth` inputs of ROWS rows (stride lda) times a panel slice to the
+// partial sums in tile. ROWS is a template argument so that the sums of
+// every row stay in registers for tiles of fewer than MICRO_ROWS rows too.
+template <int ROWS>
+static void microKernel(const double *a, size_t lda, const double *panel, int depth,
+                        double tile[MICRO_ROWS][PANEL])
+{
+#if defined(__AVX2__)
+    __m256d acc[ROWS][2];
+    for (int r = 0; r < ROWS; r++)
+    {
+        acc[r][0] = _mm256_loadu_pd(tile[r]);
+        acc[r][1] = _mm256_loadu_pd(tile[r] + 4);
+    }
+    for (int k = 0; k < depth; k++)
+    {
+        const __m256d b0 = _mm256_load_pd(panel + k * PANEL);
+        const __m256d b1 = _mm256_load_pd(panel + k * PANEL + 4);
+        for (int r = 0; r < ROWS; r++)
+        {
+            const __m256d x = _mm256_broadcast_sd(a + r * lda + k);
+            acc[r][0] = _mm256_add_pd(acc[r][0], _mm256_mul_pd(x, b0));
+            acc[r][1] = _mm256_add_pd(acc[r][1], _mm256_mul_pd(x, b1));
+        }
+    }
+    for (int r = 0; r < ROWS; r++)
+    {
+        _mm256_storeu_pd(tile[r], acc[r][0]);
+        _mm256_storeu_pd(tile[r] + 4, acc[r][1]);
+    }
+#elif defined(MLP_GEMM_SSE2)
+    // Sixteen xmm registers only hold half a tile of sums at a time.
+    for (int half = 0; half < PANEL; half += 4)
+    {
+        __m128d acc[ROWS][2];
+        for (int r = 0; r < ROWS; r++)
+        {
+            acc[r][0] = _mm_loadu_pd(tile[r] + half);
+            acc[r][1] = _mm_loadu_pd(tile[r] + half + 2);
+        }
+        for (int k = 0; k < depth; k++)
+        {
+            const __m128d b0 = _mm_load_pd(panel + k * PANEL + half);
+            const __m128d b1 = _mm_load_pd(panel + k * PANEL + half + 2);
+            for (int r = 0; r < ROWS; r++)
+            {
+                const __m128d x = _mm_load1_pd(a + r * lda + k);
+                acc[r][0] = _mm_add_pd(acc[r][0], _mm_mul_pd(x, b0));
+                acc[r][1] = _mm_add_pd(acc[r][1], _mm_mul_pd(x, b1));
+            }
+        }
+        for (int r = 0; r < ROWS; r++)
+        {
+            _mm_storeu_pd(tile[r] + half, acc[r][0]);
+            _mm_storeu_pd(tile[r] + half + 2, acc[r][1]);
+        }
+    }
+#else
+    for (int r = 0; r < ROWS; r++)
+    {
+        const double *x = a + r * lda;
+        for (int k = 0; k < depth; k++)
+        {
+            for (int j = 0; j < PANEL; j++)
+            {
+                tile[r][j] += x[k] * panel[k * PANEL + j];
+            }
+        }
+    }
+#endif
+}
+
+void packWeights(const double *weights, int inputSize, int outputSize, AlignedBuffer<double> &panels)
+{
+    const int count = (outputSize + PANEL - 1) / PANEL;
+
+    // Columns past outputSize are padded with zeros and never stored.
+    const size_t size = static_cast<size_t>(count) * inputSize * PANEL;
+    if (panels.size() != size)
+    {
+        panels.resize(size);
+    }
+    for (int p = 0; p < count; p++)
+    {
+        double *panel = panels.data() + static_cast<size_t>(p) * inputSize * PANEL;
+        for (int c = 0; c < PANEL; c++)
+        {
+            const int j = p * PANEL + c;
+            const double *row = weights + static_cast<size_t>(j) * inputSize;
+            for (int k = 0; k < inputSize; k++)
+            {
+                panel[k * PANEL + c] = j < outputSize ? row[k] : 0.0;
+            }
+        }
+    }
+}
+
+void denseBatch(const double *inputs, size_t rows, int inputSize, const double *panels,
+                const double *biases, int outputSize, double *outputs)
+{
+    const int panelCount = (outputSize + PANEL - 1) / PANEL;
+    for (size_t r0 = 0; r0 < rows; r0 += ROW_BLOCK)
+    {
+        const size_t blockRows = std::min(ROW_BLOCK, rows - r0);
+        // The first depth block starts from the biases, later ones from the
+        // partial sums already stored in outputs.
+        for (int k0 = 0; k0 == 0 || k0 < inputSize; k0 += DEPTH_BLOCK)
+        {
+            const int depth = std::min(DEPTH_BLOCK, inputSize - k0);
+            for (int p = 0; p < panelCount; p++)
+            {
+                const double *panel = panels + (static_cast<size_t>(p) * inputSize + k0) * PANEL;
+                const int firstColumn = p * PANEL;
+                const int columns = std::min(PANEL, outputSize - firstColumn);
+                for (size_t r = r0; r < r0 + blockRows; r += MICRO_ROWS)
+                {
+                    const int tileRows = static_cast<int>(std::min<size_t>(MICRO_ROWS, r0 + blockRows - r));
+                    double tile[MICRO_ROWS][PANEL] = {};
+                    for (int t = 0; t < tileRows; t++)
+                    {
+                        const double *source = k0 == 0 ? biases + firstColumn
+                                                        : outputs + (r + t) * outputSize + firstColumn;
+                        std::copy(source, source + columns, tile[t]);
+                    }
+
+                    const double *a = inputs + r * inputSize + k0;
+                    switch (tileRows)
+                    {
+                    case 1:
+                        microKernel<1>(a, inputSize, panel, depth, tile);
+                        break;
+                    case 2:
+                        microKernel<2>(a, inputSize, panel, depth, tile);
+                        break;
+                    case 3:
+                        microKernel<3>(a, inputSize, panel, depth, tile);
+                        break;
+                    default:
+                        microKernel<MICRO_ROWS>(a, inputSize, panel, depth, tile);
+                        break;
+                    }
+
+                    for (int t = 0; t < tileRows; t++)
+                    {
+                        std::copy(tile[t], tile[t] + columns, outputs + (r + t) * outputSize + firstColumn);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#include "../include/mapped_file.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path)
+    : m_data(nullptr), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Unable to open file for mapping: " + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Unable to map empty file: " + path);
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Unable to map file: " + path);
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Unable to map file: " + path);
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<unsigned char *>(view);
+    m_size = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path)
+    : m_data(nullptr), m_size(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to open file for mapping: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to map empty file: " + path);
+    }
+    void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map file: " + path);
+    }
+    m_data = static_cast<unsigned char *>(view);
+    m_size = static_cast<size_t>(info.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(m_data, m_size);
+}
+
+#endif
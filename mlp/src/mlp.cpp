@@ -1,292 +1,1197 @@
 #include "../include/mlp.h"
+#include "../include/aligned_buffer.h"
+#include "../include/mapped_file.h"
+#include "../include/model_format.h"
+#include "../include/checkpoint_writer.h"
+#include "../include/counter_rng.h"
+#include "../include/weight_codec.h"
+#include "../include/dense_kernel.h"
+#include "../include/teacher_logits.h"
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
 #include <limits>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <iterator>
 
-// The Layers structure now contains multiple hidden layers.
+// Number of samples converted from the dataset into one contiguous batch.
+static const size_t GATHER_BATCH_SIZE = 256;
+
+// Weights initialized per thread task.
+static const size_t INIT_CHUNK = 1 << 16;
+
+// Rows that forwardBatch passes through all layers together.
+static const size_t FORWARD_BLOCK_ROWS = 256;
+
+// A fully connected layer. Weights are row-major, one row of `inputs`
+// values per output neuron, and point into the network's parameter block.
+struct DenseLayer
+{
+    int inputs;
+    int outputs;
+    double *weights;
+    double *biases;
+};
+
+// Quantization-aware training: a shadow copy of the layers whose weights are
+// rounded to signed integers with one scale per row, as encodeInt8Row does
+// for 8 bits. The biases stay in floating point and are shared with the
+// network. Layer inputs are rounded to the unsigned activation grid.
+//
+// The rows are rounded again after every training step, but their scales
+// only change in refresh(), once per batch: within a batch the weights move
+// far less than one step of the grid, and rounding with a known scale is a
+// single pass over the row.
+struct FakeQuantization
+{
+    double weightLevels;     // largest integer weight
+    double activationLevels; // integer of an activation of 1
+    std::vector<DenseLayer> dense;
+    std::vector<std::vector<double>> scales; // per layer and row
+    AlignedBuffer<double> storage;
+
+    FakeQuantization(const std::vector<DenseLayer> &network, int weightBits, int activationBits)
+        : weightLevels((1 << (weightBits - 1)) - 1),
+          activationLevels((1 << activationBits) - 1)
+    {
+        size_t total = 0;
+        for (const DenseLayer &layer : network)
+        {
+            total += static_cast<size_t>(layer.inputs) * layer.outputs;
+        }
+        storage.resize(total);
+        double *next = storage.data();
+        for (const DenseLayer &layer : network)
+        {
+            DenseLayer shadow = layer;
+            shadow.weights = next;
+            dense.push_back(shadow);
+            scales.emplace_back(layer.outputs, 0.0);
+            next += static_cast<size_t>(layer.inputs) * layer.outputs;
+        }
+        refresh(network);
+    }
+
+    // Recompute the scale of every row and round all weights.
+    void refresh(const std::vector<DenseLayer> &network)
+    {
+        for (size_t l = 0; l < network.size(); l++)
+        {
+            const int n = network[l].inputs;
+            for (int row = 0; row < network[l].outputs; row++)
+            {
+                const double *in = network[l].weights + static_cast<size_t>(row) * n;
+                double maxAbs = 0.0;
+                for (int j = 0; j < n; j++)
+                {
+                    maxAbs = std::max(maxAbs, std::abs(in[j]));
+                }
+                // The scale is stored as a float in int8 model files.
+                scales[l][row] = static_cast<float>(maxAbs / weightLevels);
+                quantizeRow(network[l], static_cast<int>(l), row);
+            }
+        }
+    }
+
+    // Round one row of the network's weights into the shadow copy.
+    void quantizeRow(const DenseLayer &source, int layerIndex, int row)
+    {
+        const int n = source.inputs;
+        const double *in = source.weights + static_cast<size_t>(row) * n;
+        double *out = dense[layerIndex].weights + static_cast<size_t>(row) * n;
+        const double scale = scales[layerIndex][row];
+        if (scale == 0.0)
+        {
+            std::fill(out, out + n, 0.0);
+            return;
+        }
+        const double inverse = 1.0 / scale;
+        for (int j = 0; j < n; j++)
+        {
+            double q = std::min(weightLevels, std::max(-weightLevels, in[j] * inverse));
+            out[j] = roundToInteger(q) * scale;
+        }
+    }
+
+    void quantizeActivations(const double *in, size_t count, double *out) const
+    {
+        const double step = 1.0 / activationLevels;
+        for (size_t i = 0; i < count; i++)
+        {
+            double q = std::min(std::max(in[i], 0.0), 1.0) * activationLevels;
+            out[i] = roundToInteger(q) * step;
+        }
+    }
+
+    // Round to nearest even, for |value| < 2^51. Unlike nearbyint this
+    // needs no library call or branch, so the loops above vectorize.
+    static double roundToInteger(double value)
+    {
+        const double shift = 6755399441055744.0; // 1.5 * 2^52
+        return (value + shift) - shift;
+    }
+};
+
+// Teacher of a distillation run, see TrainingOptions::teacher.
+struct Distillation
+{
+    const TeacherLogits *teacher;
+    double temperature;
+    double alpha;
+};
+
+// All layer parameters live in a single block laid out exactly like the data
+// section of a model file (see model_format.h). The block is either owned or
+// a copy-on-write mapping of a model file.
 struct MLP::Layers
 {
-    // Each hidden layer is represented as a vector of Perceptron.
-    std::vector<std::vector<Perceptron>> hiddenLayers;
-    // Outer (output) layer.
-    std::vector<Perceptron> outerLayer;
+    // Hidden layers followed by the output layer.
+    std::vector<DenseLayer> dense;
+    double learningRate = 0.1;
+
+    AlignedBuffer<double> storage;
+    std::unique_ptr<MappedFile> mapping;
+
+    // Set while quantization-aware training runs.
+    std::unique_ptr<FakeQuantization> quantization;
+
+    // Set while a distillation run trains against a teacher.
+    std::unique_ptr<Distillation> distillation;
+
+    // Per layer, 1 for every weight that prune() kept; empty if the network
+    // has not been pruned.
+    std::vector<std::vector<unsigned char>> kept;
+
+    // Weights of forwardLayers() repacked for denseBatch, one buffer per
+    // layer. Packed by the first batched forward pass that needs them and
+    // reused by every later one until weightsChanged() is called.
+    std::vector<AlignedBuffer<double>> panels;
+    std::atomic<bool> panelsReady{false};
+    std::mutex panelsMutex;
+
+    // Layers the forward pass runs on.
+    const std::vector<DenseLayer> &forwardLayers() const
+    {
+        return quantization ? quantization->dense : dense;
+    }
+
+    // Must follow every change to the weights of forwardLayers(), and every
+    // switch between full-precision and quantized layers.
+    void weightsChanged()
+    {
+        panelsReady.store(false, std::memory_order_release);
+    }
+
+    // Panels of forwardLayers(); any number of inference threads may ask at once.
+    const std::vector<AlignedBuffer<double>> &forwardPanels()
+    {
+        if (!panelsReady.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(panelsMutex);
+            if (!panelsReady.load(std::memory_order_relaxed))
+            {
+                const std::vector<DenseLayer> &layers = forwardLayers();
+                panels.resize(layers.size());
+                for (size_t i = 0; i < layers.size(); i++)
+                {
+                    packWeights(layers[i].weights, layers[i].inputs, layers[i].outputs, panels[i]);
+                }
+                panelsReady.store(true, std::memory_order_release);
+            }
+        }
+        return panels;
+    }
+
+    std::vector<int> layerSizes() const
+    {
+        std::vector<int> sizes;
+        for (const DenseLayer &layer : dense)
+        {
+            sizes.push_back(layer.outputs);
+        }
+        return sizes;
+    }
+
+    // Point the layers at a parameter block with the model file layout.
+    void bind(unsigned char *data, int inputSize, const std::vector<int> &sizes)
+    {
+        ModelLayout layout(inputSize, sizes, MODEL_SCALAR_FLOAT64);
+        dense.clear();
+        kept.clear();
+        weightsChanged();
+        int previousSize = inputSize;
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            DenseLayer layer;
+            layer.inputs = previousSize;
+            layer.outputs = sizes[i];
+            layer.weights = reinterpret_cast<double *>(data + layout.weightOffsets[i]);
+            layer.biases = reinterpret_cast<double *>(data + layout.biasOffsets[i]);
+            dense.push_back(layer);
+            previousSize = sizes[i];
+        }
+    }
+
+    // Allocate an owned, zeroed parameter block for the given topology.
+    void allocate(int inputSize, const std::vector<int> &sizes)
+    {
+        ModelLayout layout(inputSize, sizes, MODEL_SCALAR_FLOAT64);
+        mapping.reset();
+        storage.resize(layout.dataSize / sizeof(double));
+        storage.fill(0.0);
+        bind(reinterpret_cast<unsigned char *>(storage.data()), inputSize, sizes);
+    }
+
+    // Start of the parameter block.
+    unsigned char *data() const
+    {
+        return dense.empty() ? nullptr : reinterpret_cast<unsigned char *>(dense.front().weights);
+    }
+};
+
+struct MLP::TrainingProgress
+{
+    // First epoch still to run.
+    int nextEpoch = 0;
+
+    // Early stopping.
+    double bestAccuracy = 0.0;
+    int epochsWithoutImprovement = 0;
+
+    // Snapshot of the best weights so far.
+    CheckpointWriter::Image bestModel;
+    double bestModelAccuracy = -1.0;
+    int bestEpoch = 0;
+
+    uint64_t seed = 0;
 };
 
 // Constructor: builds the network from input -> (multiple hidden layers) -> output.
 MLP::MLP(int inputSize, const std::vector<int> &hiddenSizes,
-         int outputSize, double learningRate)
+         int outputSize, double learningRate, WeightInit init, uint64_t seed)
     : m_Layers(new Layers())
 {
-    int previousSize = inputSize;
-    // Create each hidden layer.
-    for (int size : hiddenSizes)
+    std::vector<int> sizes = hiddenSizes;
+    sizes.push_back(outputSize);
+    for (int size : sizes)
+    {
+        if (size <= 0)
+        {
+            delete m_Layers;
+            throw std::invalid_argument("Layer sizes must be positive");
+        }
+    }
+    m_Layers->learningRate = learningRate;
+    m_Layers->allocate(inputSize, sizes);
+    initializeWeights(init, seed);
+}
+
+void MLP::initializeWeights(WeightInit init, uint64_t seed)
+{
+    for (size_t l = 0; l < m_Layers->dense.size(); l++)
     {
-        std::vector<Perceptron> layer;
-        layer.reserve(size);
-        for (int i = 0; i < size; i++)
+        DenseLayer &layer = m_Layers->dense[l];
+        const size_t numWeights = static_cast<size_t>(layer.outputs) * layer.inputs;
+
+        // Uniform limits: Xavier 4 * sqrt(6 / (fanIn + fanOut)), the variant
+        // Glorot & Bengio give for sigmoid networks; He sqrt(6 / fanIn).
+        double limit = 1.0;
+        if (init == WeightInit::Xavier)
+        {
+            limit = 4.0 * std::sqrt(6.0 / (layer.inputs + layer.outputs));
+        }
+        else if (init == WeightInit::He)
+        {
+            limit = std::sqrt(6.0 / layer.inputs);
+        }
+
+        // Counters 0..numWeights-1 are the weights, the biases follow.
+        const CounterRng rng(seed, l);
+        auto value = [&rng](uint64_t counter, double range)
+        {
+            return ((rng.at(counter) >> 11) * (1.0 / 9007199254740992.0) * 2.0 - 1.0) * range;
+        };
+        auto fill = [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                layer.weights[i] = value(i, limit);
+            }
+        };
+
+        size_t chunks = (numWeights + INIT_CHUNK - 1) / INIT_CHUNK;
+        size_t threads = std::min<size_t>(chunks, std::max(1u, std::thread::hardware_concurrency()));
+        if (threads <= 1)
+        {
+            fill(0, numWeights);
+        }
+        else
+        {
+            std::vector<std::thread> pool;
+            for (size_t t = 0; t < threads; t++)
+            {
+                pool.emplace_back([&, t]
+                                  {
+                    for (size_t c = t; c < chunks; c += threads)
+                    {
+                        fill(c * INIT_CHUNK, std::min(numWeights, (c + 1) * INIT_CHUNK));
+                    } });
+            }
+            for (std::thread &worker : pool)
+            {
+                worker.join();
+            }
+        }
+
+        // Xavier and He start the biases at zero.
+        for (int i = 0; i < layer.outputs; i++)
         {
-            layer.emplace_back(previousSize, learningRate);
+            layer.biases[i] = init == WeightInit::Uniform ? value(numWeights + i, 1.0) : 0.0;
         }
-        m_Layers->hiddenLayers.push_back(layer);
-        previousSize = size;
     }
-    // Create the output (outer) layer.
-    for (int i = 0; i < outputSize; i++)
+    m_Layers->weightsChanged();
+}
+
+MLP::MLP()
+    : m_Layers(new Layers())
+{
+}
+
+MLP MLP::fromFile(const std::string &filename, bool mapFile)
+{
+    MLP mlp;
+    mlp.loadModel(filename, mapFile);
+    return mlp;
+}
+
+MLP::MLP(MLP &&other) noexcept
+    : m_Layers(other.m_Layers)
+{
+    other.m_Layers = nullptr;
+}
+
+MLP &MLP::operator=(MLP &&other) noexcept
+{
+    if (this != &other)
+    {
+        delete m_Layers;
+        m_Layers = other.m_Layers;
+        other.m_Layers = nullptr;
+    }
+    return *this;
+}
+
+MLP::~MLP()
+{
+    delete m_Layers;
+}
+
+// Number of inputs expected by the first layer.
+int MLP::inputSize() const
+{
+    return m_Layers->dense.empty() ? 0 : m_Layers->dense.front().inputs;
+}
+
+int MLP::outputSize() const
+{
+    return m_Layers->dense.empty() ? 0 : m_Layers->dense.back().outputs;
+}
+
+int MLP::numLayers() const
+{
+    return static_cast<int>(m_Layers->dense.size());
+}
+
+LayerParameters MLP::layer(int index) const
+{
+    if (index < 0 || index >= numLayers())
     {
-        m_Layers->outerLayer.emplace_back(previousSize, learningRate);
+        throw std::out_of_range("Layer index out of range");
     }
+    const DenseLayer &layer = m_Layers->dense[index];
+    return {layer.inputs, layer.outputs, layer.weights, layer.biases};
 }
 
 // Helper: calculates the output of a single layer.
-std::vector<double>
-MLP::computeLayerOutput(const std::vector<Perceptron> &layer,
-                        const std::vector<double> &inputs,
-                        bool skipActivation)
+void MLP::computeLayerOutput(int layerIndex, const double *inputs, double *outputs,
+                             bool skipActivation) const
+{
+    const DenseLayer &layer = m_Layers->forwardLayers()[layerIndex];
+    for (int i = 0; i < layer.outputs; i++)
+    {
+        const double *row = layer.weights + static_cast<size_t>(i) * layer.inputs;
+        double sum = layer.biases[i];
+        for (int j = 0; j < layer.inputs; j++)
+        {
+            sum += row[j] * inputs[j];
+        }
+        // Apply sigmoid only for hidden layers
+        outputs[i] = skipActivation ? sum : 1.0 / (1.0 + std::exp(-sum));
+    }
+}
+
+// Raw output-layer values of one sample, computed layer by layer from the
+// weights themselves rather than the packed panels, which may be stale
+// while a batch is training.
+std::vector<double> MLP::forwardUnpacked(const double *inputs) const
 {
-    if (layer.empty())
+    const std::vector<DenseLayer> &layers = m_Layers->forwardLayers();
+    const FakeQuantization *quantization = m_Layers->quantization.get();
+    std::vector<double> in(inputs, inputs + inputSize());
+    if (quantization)
+    {
+        quantization->quantizeActivations(in.data(), in.size(), in.data());
+    }
+    const int numLayers = static_cast<int>(layers.size());
+    for (int i = 0; i < numLayers; i++)
     {
-        throw std::runtime_error("Layer is empty.");
+        std::vector<double> out(layers[i].outputs);
+        computeLayerOutput(i, in.data(), out.data(), i + 1 == numLayers);
+        if (quantization && i + 1 < numLayers)
+        {
+            quantization->quantizeActivations(out.data(), out.size(), out.data());
+        }
+        in = std::move(out);
     }
-    if (inputs.size() != layer[0].getWeights().size())
+    return in;
+}
+
+// Softmax of one row of n values; out may equal in.
+static void softmaxRow(const double *in, int n, double *out)
+{
+    // Find max for numerical stability
+    double maxVal = *std::max_element(in, in + n);
+
+    // Calculate exp(x - max) and sum
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        out[i] = std::exp(in[i] - maxVal);
+        sum += out[i];
+    }
+
+    // Normalize
+    for (int i = 0; i < n; i++)
+    {
+        out[i] /= sum;
+    }
+}
+
+// Helper: applies softmax to a vector of values
+std::vector<double> MLP::applySoftmax(const std::vector<double> &inputs)
+{
+    std::vector<double> output(inputs.size());
+    softmaxRow(inputs.data(), static_cast<int>(inputs.size()), output.data());
+    return output;
+}
+
+struct InferenceContext::Buffers
+{
+    AlignedBuffer<double> activations[2];
+    AlignedBuffer<double> outputs;
+};
+
+InferenceContext::InferenceContext()
+    : m_Buffers(new Buffers())
+{
+}
+
+InferenceContext::~InferenceContext()
+{
+    delete m_Buffers;
+}
+
+// Context of the calling thread, for the inference calls that don't take one.
+static InferenceContext &threadContext()
+{
+    thread_local InferenceContext context;
+    return context;
+}
+
+// Grow a scratch buffer to hold at least size values; contents are not kept.
+static void reserveScratch(AlignedBuffer<double> &buffer, size_t size)
+{
+    if (buffer.size() < size)
+    {
+        buffer.resize(size);
+    }
+}
+
+// Run blocks of up to FORWARD_BLOCK_ROWS rows through every layer and hand
+// the raw output-layer values of each block to emit(firstRow, rows, raw).
+// With a quantization the inputs of every layer are rounded to its grid.
+// Only the scratch buffers are written, never the layers.
+template <typename Emit>
+static void forwardBlocks(const std::vector<DenseLayer> &dense,
+                          const std::vector<AlignedBuffer<double>> &panels,
+                          const FakeQuantization *quantization, const double *inputs, size_t count,
+                          AlignedBuffer<double> (&activations)[2], Emit emit)
+{
+    if (dense.empty())
+    {
+        throw std::runtime_error("The network has no layers");
+    }
+    int widest = 0;
+    for (const DenseLayer &layer : dense)
+    {
+        widest = std::max(widest, layer.outputs);
+    }
+    const size_t blockRows = std::min(count, FORWARD_BLOCK_ROWS);
+    const int inputSize = dense.front().inputs;
+    reserveScratch(activations[0], blockRows * widest);
+    // The rounded network inputs go to the buffer the first layer doesn't write.
+    reserveScratch(activations[1], blockRows * (quantization ? std::max(widest, inputSize) : widest));
+
+    for (size_t first = 0; first < count; first += blockRows)
+    {
+        const size_t rows = std::min(blockRows, count - first);
+        const double *layerInput = inputs + first * inputSize;
+        if (quantization)
+        {
+            quantization->quantizeActivations(layerInput, rows * inputSize, activations[1].data());
+            layerInput = activations[1].data();
+        }
+        for (size_t i = 0; i < dense.size(); i++)
+        {
+            const DenseLayer &layer = dense[i];
+            double *out = activations[i % 2].data();
+            denseBatch(layerInput, rows, layer.inputs, panels[i].data(), layer.biases, layer.outputs, out);
+            // Sigmoid for the hidden layers only
+            if (i + 1 < dense.size())
+            {
+                for (size_t j = 0; j < rows * layer.outputs; j++)
+                {
+                    out[j] = 1.0 / (1.0 + std::exp(-out[j]));
+                }
+                if (quantization)
+                {
+                    quantization->quantizeActivations(out, rows * layer.outputs, out);
+                }
+            }
+            layerInput = out;
+        }
+        emit(first, rows, layerInput);
+    }
+}
+
+void MLP::forwardBatch(const double *inputs, size_t count, double *probabilities) const
+{
+    forwardBatch(inputs, count, probabilities, threadContext());
+}
+
+void MLP::forwardBatch(const double *inputs, size_t count, int *classes) const
+{
+    forwardBatch(inputs, count, classes, threadContext());
+}
+
+void MLP::forwardBatch(const double *inputs, size_t count, double *probabilities,
+                       InferenceContext &context) const
+{
+    InferenceContext::Buffers &buffers = *context.m_Buffers;
+    const int n = outputSize();
+    forwardBlocks(m_Layers->forwardLayers(), m_Layers->forwardPanels(), m_Layers->quantization.get(),
+                  inputs, count, buffers.activations,
+                  [&](size_t first, size_t rows, const double *raw)
+                  {
+        for (size_t r = 0; r < rows; r++)
+        {
+            softmaxRow(raw + r * n, n, probabilities + (first + r) * n);
+        } });
+}
+
+// Softmax keeps the order of the outputs, so the class is read off the raw values.
+void MLP::forwardBatch(const double *inputs, size_t count, int *classes,
+                       InferenceContext &context) const
+{
+    InferenceContext::Buffers &buffers = *context.m_Buffers;
+    const int n = outputSize();
+    forwardBlocks(m_Layers->forwardLayers(), m_Layers->forwardPanels(), m_Layers->quantization.get(),
+                  inputs, count, buffers.activations,
+                  [&](size_t first, size_t rows, const double *raw)
+                  {
+        for (size_t r = 0; r < rows; r++)
+        {
+            const double *row = raw + r * n;
+            classes[first + r] = static_cast<int>(std::max_element(row, row + n) - row);
+        } });
+}
+
+// Forward pass: propagate input through every hidden layer then the output layer.
+std::vector<double> MLP::forward(const std::vector<double> &inputs) const
+{
+    if (static_cast<int>(inputs.size()) != inputSize())
     {
         throw std::invalid_argument(
             "Size of inputs doesn't match perceptron input size");
     }
+    return forward(inputs.data());
+}
+
+std::vector<double> MLP::forward(const double *inputs) const
+{
+    const double *output = forward(inputs, threadContext());
+    return std::vector<double>(output, output + outputSize());
+}
+
+const double *MLP::forward(const double *inputs, InferenceContext &context) const
+{
+    InferenceContext::Buffers &buffers = *context.m_Buffers;
+    reserveScratch(buffers.outputs, outputSize());
+    forwardBatch(inputs, 1, buffers.outputs.data(), context);
+    return buffers.outputs.data();
+}
+
+// Training step: performs forward propagation (storing all activations)
+// and then backward propagation updating weights for all layers. During
+// quantization-aware training the forward pass and the propagated deltas use
+// the quantized weights and layer inputs, while the updates go to the
+// full-precision weights (straight-through estimator).
+void MLP::train(const double *inputs, const double *targets, const double *softTargets)
+{
+    std::vector<DenseLayer> &dense = m_Layers->dense;
+    const std::vector<DenseLayer> &forwardLayers = m_Layers->forwardLayers();
+    FakeQuantization *quantization = m_Layers->quantization.get();
+    const int numLayers = static_cast<int>(dense.size());
+    const double learningRate = m_Layers->learningRate;
+
+    // Store activations for each hidden layer; the network input is read in place.
+    std::vector<std::vector<double>> layerActivations(numLayers - 1);
+
+    // Rounded inputs of every layer when quantizing. The sigmoid derivative
+    // is still taken from the exact activations.
+    std::vector<std::vector<double>> quantizedInputs(quantization ? numLayers : 0);
+    if (quantization)
+    {
+        quantizedInputs[0].resize(inputSize());
+        quantization->quantizeActivations(inputs, inputSize(), quantizedInputs[0].data());
+    }
+    auto layerInput = [&](int layerIndex) -> const double *
+    {
+        if (quantization)
+        {
+            return quantizedInputs[layerIndex].data();
+        }
+        return layerIndex == 0 ? inputs : layerActivations[layerIndex - 1].data();
+    };
+
+    // Forward pass through all hidden layers with sigmoid
+    for (int i = 0; i < numLayers - 1; i++)
+    {
+        layerActivations[i].resize(dense[i].outputs);
+        computeLayerOutput(i, layerInput(i), layerActivations[i].data(), false);
+        if (quantization)
+        {
+            quantizedInputs[i + 1].resize(dense[i].outputs);
+            quantization->quantizeActivations(layerActivations[i].data(), dense[i].outputs,
+                                              quantizedInputs[i + 1].data());
+        }
+    }
+
+    // Compute raw outputs and softmax for the output layer
+    std::vector<double> rawOutputs(outputSize());
+    computeLayerOutput(numLayers - 1, layerInput(numLayers - 1), rawOutputs.data(), true);
+    std::vector<double> softmaxOutputs = applySoftmax(rawOutputs);
 
-    std::vector<double> outputs(layer.size(), 0.0);
-    for (size_t i = 0; i < layer.size(); i++)
+    // For softmax + cross-entropy loss, the gradient simplifies to (output - target)
+    std::vector<double> nextDeltas(rawOutputs.size());
+    for (size_t i = 0; i < nextDeltas.size(); i++)
+    {
+        nextDeltas[i] = softmaxOutputs[i] - targets[i];
+    }
+
+    // Distillation adds the cross-entropy against the teacher at temperature
+    // T, scaled by T^2; its gradient is T * (softmax(raw / T) - soft target).
+    if (softTargets)
+    {
+        const Distillation &distillation = *m_Layers->distillation;
+        const double temperature = distillation.temperature;
+        std::vector<double> softened(rawOutputs.size());
+        for (size_t i = 0; i < softened.size(); i++)
+        {
+            softened[i] = rawOutputs[i] / temperature;
+        }
+        softened = applySoftmax(softened);
+        for (size_t i = 0; i < nextDeltas.size(); i++)
+        {
+            nextDeltas[i] = (1.0 - distillation.alpha) * nextDeltas[i] +
+                            distillation.alpha * temperature * (softened[i] - softTargets[i]);
+        }
+    }
+
+    // Walk the layers backwards. Each layer's weights are updated before the
+    // deltas of the layer below are computed from them.
+    for (int layerIndex = numLayers - 1; layerIndex >= 0; layerIndex--)
+    {
+        DenseLayer &layer = dense[layerIndex];
+        const double *input = layerInput(layerIndex);
+
+        // Update weights and biases using the delta values
+        for (int i = 0; i < layer.outputs; i++)
+        {
+            double step = learningRate * nextDeltas[i];
+            double *row = layer.weights + static_cast<size_t>(i) * layer.inputs;
+            for (int j = 0; j < layer.inputs; j++)
+            {
+                row[j] -= step * input[j];
+            }
+            layer.biases[i] -= step;
+            if (!m_Layers->kept.empty())
+            {
+                const unsigned char *keep =
+                    m_Layers->kept[layerIndex].data() + static_cast<size_t>(i) * layer.inputs;
+                for (int j = 0; j < layer.inputs; j++)
+                {
+                    row[j] = keep[j] ? row[j] : 0.0;
+                }
+            }
+            if (quantization)
+            {
+                quantization->quantizeRow(layer, layerIndex, i);
+            }
+        }
+
+        if (layerIndex == 0)
+        {
+            break;
+        }
+
+        // Propagate error backwards using the sigmoid derivative
+        const double *weights = forwardLayers[layerIndex].weights;
+        const std::vector<double> &currentActivations = layerActivations[layerIndex - 1];
+        std::vector<double> currentDeltas(layer.inputs);
+        for (int i = 0; i < layer.inputs; i++)
+        {
+            double error = 0.0;
+            for (int k = 0; k < layer.outputs; k++)
+            {
+                error += weights[static_cast<size_t>(k) * layer.inputs + i] * nextDeltas[k];
+            }
+            double derivative = currentActivations[i] * (1.0 - currentActivations[i]);
+            currentDeltas[i] = error * derivative;
+        }
+        nextDeltas.swap(currentDeltas);
+    }
+}
+
+// Rank the weights of each group of layers by magnitude and zero the
+// smallest. Pruned weights are zero already, so they are ranked first.
+size_t MLP::prune(double sparsity, PruningScope scope)
+{
+    if (!(sparsity >= 0.0 && sparsity < 1.0))
+    {
+        throw std::invalid_argument("Sparsity must be in [0, 1)");
+    }
+    std::vector<DenseLayer> &dense = m_Layers->dense;
+    std::vector<std::vector<unsigned char>> &kept = m_Layers->kept;
+    if (kept.empty())
+    {
+        for (const DenseLayer &layer : dense)
+        {
+            kept.emplace_back(static_cast<size_t>(layer.inputs) * layer.outputs, 1);
+        }
+    }
+
+    std::vector<std::vector<size_t>> groups;
+    for (size_t l = 0; l < dense.size(); l++)
+    {
+        if (scope == PruningScope::PerLayer || groups.empty())
+        {
+            groups.emplace_back();
+        }
+        groups.back().push_back(l);
+    }
+
+    size_t pruned = 0;
+    for (const std::vector<size_t> &group : groups)
+    {
+        std::vector<double> magnitudes;
+        for (size_t l : group)
+        {
+            const size_t count = static_cast<size_t>(dense[l].inputs) * dense[l].outputs;
+            for (size_t i = 0; i < count; i++)
+            {
+                magnitudes.push_back(kept[l][i] ? std::abs(dense[l].weights[i]) : 0.0);
+            }
+        }
+        const size_t target = static_cast<size_t>(sparsity * magnitudes.size());
+        if (target > 0)
+        {
+            std::nth_element(magnitudes.begin(), magnitudes.begin() + (target - 1), magnitudes.end());
+            const double threshold = magnitudes[target - 1];
+            size_t below = 0;
+            for (double magnitude : magnitudes)
+            {
+                below += magnitude < threshold;
+            }
+            // Ties at the threshold are pruned in order until the target is met.
+            size_t atThreshold = target - below;
+            for (size_t l : group)
+            {
+                const size_t count = static_cast<size_t>(dense[l].inputs) * dense[l].outputs;
+                for (size_t i = 0; i < count; i++)
+                {
+                    double magnitude = kept[l][i] ? std::abs(dense[l].weights[i]) : 0.0;
+                    if (magnitude < threshold || (magnitude == threshold && atThreshold > 0))
+                    {
+                        atThreshold -= magnitude == threshold;
+                        dense[l].weights[i] = 0.0;
+                        kept[l][i] = 0;
+                    }
+                }
+            }
+        }
+        for (size_t l : group)
+        {
+            pruned += static_cast<size_t>(std::count(kept[l].begin(), kept[l].end(), 0));
+        }
+    }
+    m_Layers->weightsChanged();
+    return pruned;
+}
+
+// A helper for computing mean squared error over one training example.
+static double meanSquaredError(const double *outputs, size_t count,
+                               const double *targets)
+{
+    double error = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        error += std::pow(outputs[i] - targets[i], 2);
+    }
+    return error / count;
+}
+
+// Get predicted class from network output (index of maximum value)
+int MLP::getPredictedClass(const std::vector<double> &output)
+{
+    return static_cast<int>(std::max_element(output.begin(), output.end()) - output.begin());
+}
+
+// Run a training step for each row of the batch
+double MLP::trainBatch(const Batch &batch, size_t *correct)
+{
+    if (batch.inputSize != inputSize() || batch.outputSize != outputSize())
+    {
+        throw std::invalid_argument("Batch dimensions don't match the network");
+    }
+    const Distillation *distillation = m_Layers->distillation.get();
+    if (distillation && !batch.indices)
+    {
+        throw std::invalid_argument("Distillation needs the dataset index of every row");
+    }
+    std::vector<double> softTargets(distillation ? batch.outputSize : 0);
+
+    double totalMSE = 0.0;
+    for (size_t row = 0; row < batch.count; row++)
+    {
+        const double *inputs = batch.inputs + row * batch.inputSize;
+        const double *targets = batch.targets + row * batch.outputSize;
+        if (distillation)
+        {
+            distillation->teacher->softTargets(batch.indices[row], distillation->temperature, softTargets.data());
+            train(inputs, targets, softTargets.data());
+        }
+        else
+        {
+            train(inputs, targets);
+        }
+
+        // Compute MSE for this sample. The step has just moved the weights,
+        // so the packed panels can't be used until the batch is done.
+        std::vector<double> output = applySoftmax(forwardUnpacked(inputs));
+        totalMSE += meanSquaredError(output.data(), output.size(), targets);
+        if (correct &&
+            getPredictedClass(output) == std::max_element(targets, targets + batch.outputSize) - targets)
+        {
+            (*correct)++;
+        }
+    }
+    if (m_Layers->quantization)
+    {
+        m_Layers->quantization->refresh(m_Layers->dense);
+    }
+    // Pack the panels again, once for the whole batch, when next needed.
+    m_Layers->weightsChanged();
+
+#ifndef NDEBUG
+    // Debug builds check that inference sees the weights the batch left behind.
+    if (batch.count > 0)
+    {
+        const double *last = batch.inputs + (batch.count - 1) * batch.inputSize;
+        std::vector<double> packed = forward(last);
+        std::vector<double> unpacked = applySoftmax(forwardUnpacked(last));
+        for (size_t i = 0; i < packed.size(); i++)
+        {
+            if (std::abs(packed[i] - unpacked[i]) > 1e-12)
+            {
+                throw std::logic_error("Inference is out of date with the trained weights");
+            }
+        }
+    }
+#endif
+    return totalMSE;
+}
+
+// Accuracy over a dataset; also accumulates the summed MSE when requested
+double MLP::evaluate(const DatasetView &data, double *totalMSE) const
+{
+    if (data.size() == 0)
+    {
+        throw std::invalid_argument("Invalid dataset for accuracy computation");
+    }
+    if (data.sampleSize() != this->inputSize() || data.numClasses() != this->outputSize())
+    {
+        throw std::invalid_argument("Dataset dimensions don't match the network");
+    }
+
+    const int inputSize = data.sampleSize();
+    const int outputSize = data.numClasses();
+    std::vector<double> inputs(GATHER_BATCH_SIZE * inputSize);
+    std::vector<double> targets(GATHER_BATCH_SIZE * outputSize);
+    std::vector<double> outputs(GATHER_BATCH_SIZE * outputSize);
+
+    int correctPredictions = 0;
+    double errorSum = 0.0;
+    for (size_t first = 0; first < data.size(); first += GATHER_BATCH_SIZE)
     {
-        outputs[i] = layer[i].calcOutputRaw(inputs); // Get raw output
-        if (!skipActivation)
+        size_t count = std::min(GATHER_BATCH_SIZE, data.size() - first);
+        data.gatherRange(first, count, inputs.data(), totalMSE ? targets.data() : nullptr);
+        forwardBatch(inputs.data(), count, outputs.data());
+        for (size_t row = 0; row < count; row++)
         {
-            outputs[i] = 1.0 / (1.0 + std::exp(-outputs[i])); // Apply sigmoid only for hidden layers
+            const double *output = outputs.data() + row * outputSize;
+            if (std::max_element(output, output + outputSize) - output == data.label(first + row))
+            {
+                correctPredictions++;
+            }
+            if (totalMSE)
+            {
+                errorSum += meanSquaredError(output, outputSize, targets.data() + row * outputSize);
+            }
         }
     }
-    return outputs;
+
+    if (totalMSE)
+    {
+        *totalMSE = errorSum;
+    }
+    return static_cast<double>(correctPredictions) / data.size();
 }
 
-// Helper: applies softmax to a vector of values
-std::vector<double> MLP::applySoftmax(const std::vector<double> &inputs)
+// Compute accuracy on a dataset
+double MLP::computeAccuracy(const DatasetView &data) const
 {
-    std::vector<double> output(inputs.size());
+    return evaluate(data, nullptr);
+}
 
-    // Find max for numerical stability
-    double maxVal = *std::max_element(inputs.begin(), inputs.end());
+// Training loop with early stopping based on validation accuracy
+void MLP::startTraining(const DatasetView &training, const DatasetView &validation,
+                        int epochs, int patience,
+                        double minimalImprovement)
+{
+    TrainingOptions options;
+    options.epochs = epochs;
+    options.patience = patience;
+    options.minimalImprovement = minimalImprovement;
+    startTraining(training, validation, options);
+}
 
-    // Calculate exp(x - max) and sum
-    double sum = 0.0;
-    for (size_t i = 0; i < inputs.size(); i++)
-    {
-        output[i] = std::exp(inputs[i] - maxVal);
-        sum += output[i];
-    }
+void MLP::startTraining(const DatasetView &training, const DatasetView &validation,
+                        const TrainingOptions &options)
+{
+    std::cout << "Starting training with:" << std::endl
+              << "- Training samples: " << training.size() << std::endl;
 
-    // Normalize
-    for (size_t i = 0; i < inputs.size(); i++)
-    {
-        output[i] /= sum;
-    }
+    // Batches are gathered, converted and optionally augmented on the
+    // loader's threads while the previous batch trains.
+    BatchLoader loader(training, options.batchSize, options.shuffle, options.seed,
+                       options.prefetchDepth, options.loaderThreads, options.augment);
+    TrainingProgress progress;
+    progress.seed = options.seed;
+    runTraining(loader, &training, validation, options, progress);
+}
 
-    return output;
+// Training from a sequential source that never has to fit in memory
+void MLP::startStreamingTraining(SampleSource &training, const DatasetView &validation,
+                                 const TrainingOptions &options)
+{
+    std::cout << "Starting streaming training with:" << std::endl
+              << "- Training samples: streamed, shuffle window of "
+              << options.shuffleWindow << " samples" << std::endl;
+
+    StreamingLoader loader(training, options.batchSize, options.shuffleWindow, options.seed,
+                           options.prefetchDepth, options.augment);
+    TrainingProgress progress;
+    progress.seed = options.seed;
+    runTraining(loader, nullptr, validation, options, progress);
 }
 
-// Forward pass: propagate input through every hidden layer then the output layer.
-std::vector<double> MLP::forward(const std::vector<double> &inputs)
+// Shuffling and augmentation are keyed on (seed, epoch), so restoring the
+// seed and the epoch counter reproduces the remaining epochs exactly.
+void MLP::resumeTraining(const std::string &checkpoint, const DatasetView &training,
+                         const DatasetView &validation, const TrainingOptions &options)
 {
-    std::vector<double> activations = inputs;
-    // Pass through each hidden layer with sigmoid activation
-    for (const auto &hiddenLayer : m_Layers->hiddenLayers)
-    {
-        activations = computeLayerOutput(hiddenLayer, activations, false);
-    }
-    // Pass through the output layer without activation, then apply softmax
-    return applySoftmax(computeLayerOutput(m_Layers->outerLayer, activations, true));
+    TrainingProgress progress = loadCheckpoint(checkpoint);
+    TrainingOptions resumed = options;
+    resumed.seed = progress.seed;
+
+    std::cout << "Resuming training from " << checkpoint << " at epoch " << progress.nextEpoch + 1
+              << ":" << std::endl
+              << "- Training samples: " << training.size() << std::endl;
+
+    BatchLoader loader(training, resumed.batchSize, resumed.shuffle, resumed.seed,
+                       resumed.prefetchDepth, resumed.loaderThreads, resumed.augment);
+    runTraining(loader, &training, validation, resumed, progress);
 }
 
-// Training step: performs forward propagation (storing all activations)
-// and then backward propagation updating weights for all layers.
-void MLP::train(const std::vector<double> &inputs,
-                const std::vector<double> &targets)
+void MLP::resumeStreamingTraining(const std::string &checkpoint, SampleSource &training,
+                                  const DatasetView &validation, const TrainingOptions &options)
 {
-    // Store activations for each layer; index 0 holds the network input.
-    std::vector<std::vector<double>> layerActivations;
-    layerActivations.push_back(inputs);
+    TrainingProgress progress = loadCheckpoint(checkpoint);
+    TrainingOptions resumed = options;
+    resumed.seed = progress.seed;
 
-    // Forward pass through all hidden layers with sigmoid
-    for (const auto &hiddenLayer : m_Layers->hiddenLayers)
-    {
-        std::vector<double> activation =
-            computeLayerOutput(hiddenLayer, layerActivations.back(), false);
-        layerActivations.push_back(activation);
-    }
+    std::cout << "Resuming streaming training from " << checkpoint << " at epoch "
+              << progress.nextEpoch + 1 << ":" << std::endl
+              << "- Training samples: streamed, shuffle window of "
+              << resumed.shuffleWindow << " samples" << std::endl;
 
-    // Compute raw outputs and softmax for the output layer
-    std::vector<double> rawOutputs = computeLayerOutput(m_Layers->outerLayer, layerActivations.back(), true);
-    std::vector<double> softmaxOutputs = applySoftmax(rawOutputs);
+    StreamingLoader loader(training, resumed.batchSize, resumed.shuffleWindow, resumed.seed,
+                           resumed.prefetchDepth, resumed.augment);
+    runTraining(loader, nullptr, validation, resumed, progress);
+}
 
-    // Calculate deltas for the output layer using softmax derivative
-    std::vector<double> outputDeltas(m_Layers->outerLayer.size());
-    for (size_t i = 0; i < m_Layers->outerLayer.size(); i++)
+// Shared epoch loop with early stopping based on validation accuracy.
+// Without trainingEval the training accuracy is accumulated during the epoch.
+void MLP::runTraining(BatchProducer &loader, const DatasetView *trainingEval,
+                      const DatasetView &validation, const TrainingOptions &options,
+                      TrainingProgress &progress)
+{
+    // Snapshots copy the parameter block, which is cheap next to an epoch;
+    // the disk writes happen in the background.
+    std::unique_ptr<CheckpointWriter> writer;
+    if (!options.checkpointPath.empty())
     {
-        // For softmax + cross-entropy loss, the gradient simplifies to (output - target)
-        outputDeltas[i] = softmaxOutputs[i] - targets[i];
+        writer = std::make_unique<CheckpointWriter>();
     }
 
-    // Update weights for the output layer
-    for (size_t i = 0; i < m_Layers->outerLayer.size(); i++)
+    if (options.quantizeWeightBits != 0)
     {
-        m_Layers->outerLayer[i].updateWeights(layerActivations.back(),
-                                              outputDeltas[i]);
+        if (options.quantizeWeightBits < 2 || options.quantizeWeightBits > 8 ||
+            options.quantizeActivationBits < 1 || options.quantizeActivationBits > 8)
+        {
+            throw std::invalid_argument(
+                "Quantization-aware training needs 2 to 8 weight bits and 1 to 8 activation bits");
+        }
+        m_Layers->quantization = std::make_unique<FakeQuantization>(
+            m_Layers->dense, options.quantizeWeightBits, options.quantizeActivationBits);
+        m_Layers->weightsChanged();
     }
-
-    // Propagate error backwards through the hidden layers using sigmoid derivative
-    std::vector<double> nextDeltas = outputDeltas;
-    for (int layerIndex = static_cast<int>(m_Layers->hiddenLayers.size()) - 1;
-         layerIndex >= 0; layerIndex--)
+    // Back to full precision when the run ends, also by an exception.
+    struct QuantizationScope
     {
-        std::vector<Perceptron> &currentLayer =
-            m_Layers->hiddenLayers[layerIndex];
-        std::vector<double> &currentActivations =
-            layerActivations[layerIndex + 1];
-
-        std::vector<double> currentDeltas(currentLayer.size());
-        for (size_t i = 0; i < currentLayer.size(); i++)
+        Layers &layers;
+        ~QuantizationScope()
         {
-            double error = 0.0;
-            if (layerIndex == static_cast<int>(m_Layers->hiddenLayers.size()) - 1)
-            {
-                // Next layer is the output layer
-                for (size_t k = 0; k < m_Layers->outerLayer.size(); k++)
-                {
-                    error += m_Layers->outerLayer[k].getWeights()[i] *
-                             nextDeltas[k];
-                }
-            }
-            else
-            {
-                // Next layer is another hidden layer
-                for (size_t k = 0; k < m_Layers->hiddenLayers[layerIndex + 1].size(); k++)
-                {
-                    error += m_Layers->hiddenLayers[layerIndex + 1][k]
-                                 .getWeights()[i] *
-                             nextDeltas[k];
-                }
-            }
-            // Use sigmoid derivative for hidden layers
-            double derivative = currentActivations[i] * (1.0 - currentActivations[i]);
-            currentDeltas[i] = error * derivative;
+            layers.quantization.reset();
+            layers.weightsChanged();
         }
+    } quantizationScope{*m_Layers};
 
-        // Update weights for the current hidden layer
-        for (size_t i = 0; i < currentLayer.size(); i++)
+    if (options.teacher)
+    {
+        const TeacherLogits &teacher = *options.teacher;
+        if (!(options.distillationTemperature > 0.0) ||
+            !(options.distillationAlpha >= 0.0 && options.distillationAlpha <= 1.0))
+        {
+            throw std::invalid_argument("Distillation needs a positive temperature and an alpha in [0, 1]");
+        }
+        if (!trainingEval || &trainingEval->dataset() != &teacher.dataset())
+        {
+            throw std::invalid_argument("Distillation needs teacher logits of the training dataset");
+        }
+        if (teacher.numClasses() != outputSize())
         {
-            currentLayer[i].updateWeights(layerActivations[layerIndex],
-                                          currentDeltas[i]);
+            throw std::invalid_argument("Teacher outputs don't match the network");
         }
-        nextDeltas = currentDeltas;
+        m_Layers->distillation = std::make_unique<Distillation>(
+            Distillation{options.teacher, options.distillationTemperature, options.distillationAlpha});
     }
-}
-
-// A helper for computing mean squared error over one training example.
-double meanSquaredError(const std::vector<double> &outputs,
-                        const std::vector<double> &targets)
-{
-    if (outputs.size() != targets.size())
+    struct DistillationScope
     {
-        throw std::invalid_argument(
-            "Output size doesn't match targets size");
-    }
-    double error = 0.0;
-    for (size_t i = 0; i < outputs.size(); i++)
+        std::unique_ptr<Distillation> &distillation;
+        ~DistillationScope() { distillation.reset(); }
+    } distillationScope{m_Layers->distillation};
+
+    std::cout << "- Validation samples: " << validation.size() << std::endl
+              << "- Max epochs: " << options.epochs << std::endl
+              << "- Early stopping patience: " << options.patience << " epochs" << std::endl
+              << "- Minimal improvement threshold: " << options.minimalImprovement << std::endl
+              << "- Batch size: " << options.batchSize
+              << (options.shuffle ? " (shuffled)" : "") << std::endl;
+    if (m_Layers->quantization)
     {
-        error += std::pow(outputs[i] - targets[i], 2);
+        std::cout << "- Quantization-aware: " << options.quantizeWeightBits << "-bit weights, "
+                  << options.quantizeActivationBits << "-bit activations" << std::endl;
     }
-    return error / outputs.size();
-}
-
-// Get predicted class from network output (index of maximum value)
-int MLP::getPredictedClass(const std::vector<double> &output)
-{
-    return static_cast<int>(std::max_element(output.begin(), output.end()) - output.begin());
-}
-
-// Compute accuracy on a dataset
-double MLP::computeAccuracy(const std::vector<std::vector<double>> &inputs,
-                            const std::vector<std::vector<double>> &targets)
-{
-    if (inputs.size() != targets.size() || inputs.empty())
+    if (m_Layers->distillation)
     {
-        throw std::invalid_argument("Invalid dataset for accuracy computation");
+        std::cout << "- Distillation: temperature " << options.distillationTemperature << ", alpha "
+                  << options.distillationAlpha << std::endl;
     }
-
-    int correctPredictions = 0;
-    for (size_t i = 0; i < inputs.size(); i++)
+    if (writer)
     {
-        std::vector<double> output = forward(inputs[i]);
-        int predictedClass = getPredictedClass(output);
-        int targetClass = getPredictedClass(targets[i]); // Convert one-hot to class index
-        if (predictedClass == targetClass)
+        std::cout << "- Checkpoints: " << options.checkpointPath;
+        if (options.checkpointInterval > 0)
         {
-            correctPredictions++;
+            std::cout << " (every " << options.checkpointInterval << " epochs to "
+                      << options.checkpointPath << ".last)";
         }
+        std::cout << std::endl;
     }
 
-    return static_cast<double>(correctPredictions) / inputs.size();
-}
-
-// Training loop with early stopping based on validation accuracy
-void MLP::startTraining(const std::vector<std::vector<double>> &trainingInputs,
-                        const std::vector<std::vector<double>> &trainingTargets,
-                        const std::vector<std::vector<double>> &validationInputs,
-                        const std::vector<std::vector<double>> &validationTargets,
-                        int epochs, int patience,
-                        double minimalImprovement)
-{
-    double bestAccuracy = 0.0;
-    int epochsWithoutImprovement = 0;
-
-    std::cout << "Starting training with:" << std::endl
-              << "- Training samples: " << trainingInputs.size() << std::endl
-              << "- Validation samples: " << validationInputs.size() << std::endl
-              << "- Max epochs: " << epochs << std::endl
-              << "- Early stopping patience: " << patience << " epochs" << std::endl
-              << "- Minimal improvement threshold: " << minimalImprovement << std::endl;
-
     // Print header for the training log
     std::cout << "\nEpoch  Train Loss   Train Acc   Val Loss    Val Acc" << std::endl;
     std::cout << "------------------------------------------------" << std::endl;
 
-    for (int epoch = 0; epoch < epochs; epoch++)
+    auto trainingStart = std::chrono::steady_clock::now();
+
+    for (int epoch = progress.nextEpoch; epoch < options.epochs; epoch++)
     {
         double trainTotalMSE = 0.0;
+        size_t trainSamples = 0;
+        size_t trainCorrect = 0;
 
         // Training phase
-        for (size_t i = 0; i < trainingInputs.size(); i++)
+        loader.startEpoch(epoch);
+        Batch batch;
+        while (loader.next(batch))
         {
-            train(trainingInputs[i], trainingTargets[i]);
-
-            // Compute MSE for this sample
-            std::vector<double> output = forward(trainingInputs[i]);
-            trainTotalMSE += meanSquaredError(output, trainingTargets[i]);
+            trainTotalMSE += trainBatch(batch, trainingEval ? nullptr : &trainCorrect);
+            trainSamples += batch.count;
+        }
+        if (trainSamples == 0)
+        {
+            throw std::runtime_error("Training data is empty");
         }
 
         // Compute average MSE and accuracies
-        double trainMSE = trainTotalMSE / trainingInputs.size();
-        double trainAccuracy = computeAccuracy(trainingInputs, trainingTargets);
+        double trainMSE = trainTotalMSE / trainSamples;
+        double trainAccuracy = trainingEval ? computeAccuracy(*trainingEval)
+                                            : static_cast<double>(trainCorrect) / trainSamples;
 
         // Compute validation metrics
         double valTotalMSE = 0.0;
-        for (size_t i = 0; i < validationInputs.size(); i++)
-        {
-            std::vector<double> output = forward(validationInputs[i]);
-            valTotalMSE += meanSquaredError(output, validationTargets[i]);
-        }
-        double valMSE = valTotalMSE / validationInputs.size();
-        double valAccuracy = computeAccuracy(validationInputs, validationTargets);
+        double valAccuracy = evaluate(validation, &valTotalMSE);
+        double valMSE = valTotalMSE / validation.size();
 
         // Print metrics in a clean tabular format
         printf("%3d    %.6f   %6.2f%%    %.6f   %6.2f%%\n",
@@ -296,93 +1201,515 @@ void MLP::startTraining(const std::vector<std::vector<double>> &trainingInputs,
                valMSE,
                valAccuracy * 100.0);
 
+        if (valAccuracy > progress.bestModelAccuracy)
+        {
+            progress.bestModelAccuracy = valAccuracy;
+            progress.bestEpoch = epoch + 1;
+            if (options.restoreBestWeights || writer)
+            {
+                progress.bestModel = std::make_shared<const std::vector<unsigned char>>(serializeModel(MODEL_SCALAR_FLOAT64));
+            }
+            if (writer)
+            {
+                writer->submit(options.checkpointPath, progress.bestModel);
+            }
+        }
+
         // Early stopping check based on validation accuracy
-        if (valAccuracy > bestAccuracy + minimalImprovement)
+        if (valAccuracy > progress.bestAccuracy + options.minimalImprovement)
         {
-            bestAccuracy = valAccuracy;
-            epochsWithoutImprovement = 0;
+            progress.bestAccuracy = valAccuracy;
+            progress.epochsWithoutImprovement = 0;
         }
         else
         {
-            epochsWithoutImprovement++;
+            progress.epochsWithoutImprovement++;
+        }
+        progress.nextEpoch = epoch + 1;
+
+        if (writer && options.checkpointInterval > 0 && (epoch + 1) % options.checkpointInterval == 0)
+        {
+            writer->submit(options.checkpointPath + ".last",
+                           std::make_shared<const std::vector<unsigned char>>(serializeCheckpoint(progress)));
         }
 
-        if (epochsWithoutImprovement >= patience)
+        if (progress.epochsWithoutImprovement >= options.patience)
         {
             std::cout << "\nEarly stopping triggered after " << epoch + 1
                       << " epochs. Best validation accuracy: "
-                      << (bestAccuracy * 100.0) << "%" << std::endl;
+                      << (progress.bestAccuracy * 100.0) << "%" << std::endl;
             break;
         }
     }
+
+    // The full-precision weights are kept; quantizing them again gives the
+    // network that was validated.
+    m_Layers->quantization.reset();
+    m_Layers->weightsChanged();
+    if (options.restoreBestWeights && progress.bestModel)
+    {
+        restoreModel(*progress.bestModel);
+        std::cout << "Restored weights of epoch " << progress.bestEpoch << " (validation accuracy "
+                  << (progress.bestModelAccuracy * 100.0) << "%)" << std::endl;
+    }
+    if (writer)
+    {
+        writer->flush();
+    }
+
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - trainingStart).count();
+    printf("Input pipeline stall: %.3f s over %zu batches (%.2f%% of training time)\n",
+           loader.stallSeconds(), loader.batchesServed(),
+           totalSeconds > 0.0 ? loader.stallSeconds() / totalSeconds * 100.0 : 0.0);
+}
+
+// Write one layer in a compact scalar type, see model_format.h.
+static void encodeLayer(const DenseLayer &layer, uint32_t scalarType, const ModelLayout &layout,
+                        size_t index, unsigned char *data)
+{
+    const size_t numWeights = static_cast<size_t>(layer.outputs) * layer.inputs;
+    unsigned char *weights = data + layout.weightOffsets[index];
+    unsigned char *biases = data + layout.biasOffsets[index];
+    switch (scalarType)
+    {
+    case MODEL_SCALAR_FLOAT32:
+        encodeFloat32(layer.weights, numWeights, reinterpret_cast<float *>(weights));
+        encodeFloat32(layer.biases, layer.outputs, reinterpret_cast<float *>(biases));
+        break;
+    case MODEL_SCALAR_FLOAT16:
+        encodeFloat16(layer.weights, numWeights, reinterpret_cast<uint16_t *>(weights));
+        encodeFloat16(layer.biases, layer.outputs, reinterpret_cast<uint16_t *>(biases));
+        break;
+    case MODEL_SCALAR_BFLOAT16:
+        encodeBFloat16(layer.weights, numWeights, reinterpret_cast<uint16_t *>(weights));
+        encodeBFloat16(layer.biases, layer.outputs, reinterpret_cast<uint16_t *>(biases));
+        break;
+    case MODEL_SCALAR_INT8:
+    {
+        float *scales = reinterpret_cast<float *>(data + layout.scaleOffsets[index]);
+        for (int row = 0; row < layer.outputs; row++)
+        {
+            scales[row] = encodeInt8Row(layer.weights + static_cast<size_t>(row) * layer.inputs, layer.inputs,
+                                        reinterpret_cast<int8_t *>(weights) + static_cast<size_t>(row) * layer.inputs);
+        }
+        encodeFloat32(layer.biases, layer.outputs, reinterpret_cast<float *>(biases));
+        break;
+    }
+    default:
+        throw std::invalid_argument("Unsupported model scalar type");
+    }
+}
+
+// Widen one layer stored in a compact scalar type to the compute type.
+static void decodeLayer(const unsigned char *data, uint32_t scalarType, const ModelLayout &layout,
+                        size_t index, DenseLayer &layer)
+{
+    const size_t numWeights = static_cast<size_t>(layer.outputs) * layer.inputs;
+    const unsigned char *weights = data + layout.weightOffsets[index];
+    const unsigned char *biases = data + layout.biasOffsets[index];
+    switch (scalarType)
+    {
+    case MODEL_SCALAR_FLOAT64:
+        std::memcpy(layer.weights, weights, numWeights * sizeof(double));
+        std::memcpy(layer.biases, biases, layer.outputs * sizeof(double));
+        break;
+    case MODEL_SCALAR_FLOAT32:
+        decodeFloat32(reinterpret_cast<const float *>(weights), numWeights, layer.weights);
+        decodeFloat32(reinterpret_cast<const float *>(biases), layer.outputs, layer.biases);
+        break;
+    case MODEL_SCALAR_FLOAT16:
+        decodeFloat16(reinterpret_cast<const uint16_t *>(weights), numWeights, layer.weights);
+        decodeFloat16(reinterpret_cast<const uint16_t *>(biases), layer.outputs, layer.biases);
+        break;
+    case MODEL_SCALAR_BFLOAT16:
+        decodeBFloat16(reinterpret_cast<const uint16_t *>(weights), numWeights, layer.weights);
+        decodeBFloat16(reinterpret_cast<const uint16_t *>(biases), layer.outputs, layer.biases);
+        break;
+    case MODEL_SCALAR_INT8:
+    {
+        const float *scales = reinterpret_cast<const float *>(data + layout.scaleOffsets[index]);
+        for (int row = 0; row < layer.outputs; row++)
+        {
+            decodeInt8Row(reinterpret_cast<const int8_t *>(weights) + static_cast<size_t>(row) * layer.inputs,
+                          layer.inputs, scales[row], layer.weights + static_cast<size_t>(row) * layer.inputs);
+        }
+        decodeFloat32(reinterpret_cast<const float *>(biases), layer.outputs, layer.biases);
+        break;
+    }
+    default:
+        throw std::invalid_argument("Unsupported model scalar type");
+    }
 }
 
-// Save the network model to a file in binary format.
-void MLP::saveModel(const std::string &filename)
+// Save the network model to a file in the aligned binary format.
+void MLP::saveModel(const std::string &filename, ModelScalarType scalarType) const
 {
+    std::vector<unsigned char> image = serializeModel(scalarType);
+
     std::ofstream ofs(filename, std::ios::binary);
     if (!ofs)
     {
         throw std::runtime_error("Unable to open file for saving: " + filename);
     }
+    ofs.write(reinterpret_cast<const char *>(image.data()), image.size());
+    if (!ofs)
+    {
+        throw std::runtime_error("Failed to write model file: " + filename);
+    }
+    ofs.close();
+}
+
+std::vector<unsigned char> MLP::serializeModel(ModelScalarType scalarType) const
+{
+    if (modelScalarBytes(scalarType) == 0)
+    {
+        throw std::invalid_argument("Unsupported model scalar type");
+    }
+
+    std::vector<int> sizes = m_Layers->layerSizes();
+    ModelLayout layout(inputSize(), sizes, scalarType);
+    ModelFileHeader header = {};
+    std::memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version = MODEL_VERSION;
+    header.scalarType = scalarType;
+    header.inputSize = static_cast<uint32_t>(inputSize());
+    header.numLayers = static_cast<uint32_t>(sizes.size());
+    header.learningRate = m_Layers->learningRate;
+    header.dataOffset = modelDataOffset(sizes.size());
+    header.dataSize = layout.dataSize;
+
+    // Header, layer sizes and padding; the buffer starts out zeroed.
+    std::vector<unsigned char> image(header.dataOffset + header.dataSize, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        uint32_t layerSize = static_cast<uint32_t>(sizes[i]);
+        std::memcpy(image.data() + sizeof(header) + i * sizeof(uint32_t), &layerSize, sizeof(layerSize));
+    }
 
-    // Save the number and configuration of hidden layers.
-    size_t numHiddenLayers = m_Layers->hiddenLayers.size();
-    ofs.write(reinterpret_cast<const char *>(&numHiddenLayers),
-              sizeof(numHiddenLayers));
-    for (const auto &hiddenLayer : m_Layers->hiddenLayers)
+    unsigned char *data = image.data() + header.dataOffset;
+    if (scalarType == MODEL_SCALAR_FLOAT64)
+    {
+        // The parameter block already has the on-disk layout.
+        std::memcpy(data, m_Layers->data(), header.dataSize);
+    }
+    else
     {
-        size_t layerSize = hiddenLayer.size();
-        ofs.write(reinterpret_cast<const char *>(&layerSize),
-                  sizeof(layerSize));
-        for (const Perceptron &perceptron : hiddenLayer)
+        for (size_t i = 0; i < m_Layers->dense.size(); i++)
         {
-            perceptron.save(ofs);
+            encodeLayer(m_Layers->dense[i], scalarType, layout, i, data);
         }
     }
+    return image;
+}
+
+std::vector<unsigned char> MLP::serializeCheckpoint(const TrainingProgress &progress) const
+{
+    std::vector<unsigned char> image = serializeModel(MODEL_SCALAR_FLOAT64);
 
-    // Save the outer (output) layer.
-    size_t outerSize = m_Layers->outerLayer.size();
-    ofs.write(reinterpret_cast<const char *>(&outerSize), sizeof(outerSize));
-    for (const Perceptron &perceptron : m_Layers->outerLayer)
+    TrainingStateHeader state = {};
+    std::memcpy(state.magic, TRAINING_STATE_MAGIC, sizeof(state.magic));
+    state.version = TRAINING_STATE_VERSION;
+    state.nextEpoch = progress.nextEpoch;
+    state.epochsWithoutImprovement = progress.epochsWithoutImprovement;
+    state.bestEpoch = progress.bestEpoch;
+    state.bestAccuracy = progress.bestAccuracy;
+    state.bestModelAccuracy = progress.bestModelAccuracy;
+    state.seed = progress.seed;
+    state.bestModelSize = progress.bestModel ? progress.bestModel->size() : 0;
+
+    const unsigned char *stateBytes = reinterpret_cast<const unsigned char *>(&state);
+    image.insert(image.end(), stateBytes, stateBytes + sizeof(state));
+    if (progress.bestModel)
     {
-        perceptron.save(ofs);
+        image.insert(image.end(), progress.bestModel->begin(), progress.bestModel->end());
     }
-    ofs.close();
+    return image;
+}
+
+void MLP::restoreModel(const std::vector<unsigned char> &image)
+{
+    ModelFileHeader header;
+    std::memcpy(&header, image.data(), sizeof(header));
+    std::memcpy(m_Layers->data(), image.data() + header.dataOffset,
+                header.dataSize);
+    m_Layers->weightsChanged();
+}
+
+// Load a saved network model from a file. Files in the aligned format are
+// memory-mapped and used in place; files without the magic number are read
+// as the legacy per-perceptron stream.
+void MLP::loadModel(const std::string &filename, bool mapFile)
+{
+    {
+        std::ifstream probe(filename, std::ios::binary);
+        if (!probe)
+        {
+            throw std::runtime_error("Unable to open file for loading: " + filename);
+        }
+        char magic[sizeof(MODEL_MAGIC)] = {};
+        probe.read(magic, sizeof(magic));
+        if (!probe || std::memcmp(magic, MODEL_MAGIC, sizeof(magic)) != 0)
+        {
+            probe.close();
+            loadLegacyModel(filename);
+            return;
+        }
+    }
+
+    if (mapFile)
+    {
+        auto mapping = std::make_unique<MappedFile>(filename);
+        loadModelImage(mapping->data(), mapping->size(), filename, &mapping);
+    }
+    else
+    {
+        std::ifstream ifs(filename, std::ios::binary);
+        std::vector<unsigned char> image((std::istreambuf_iterator<char>(ifs)),
+                                         std::istreambuf_iterator<char>());
+        loadModelImage(image.data(), image.size(), filename, nullptr);
+    }
+}
+
+size_t MLP::loadModelImage(const unsigned char *image, size_t size, const std::string &filename,
+                           std::unique_ptr<MappedFile> *mapping)
+{
+    ModelFileHeader header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error("Model file is truncated: " + filename);
+    }
+    std::memcpy(&header, image, sizeof(header));
+    if (header.version != MODEL_VERSION)
+    {
+        throw std::runtime_error("Unsupported model file version: " + filename);
+    }
+    if (modelScalarBytes(header.scalarType) == 0)
+    {
+        throw std::runtime_error("Unsupported model scalar type: " + filename);
+    }
+    if (header.numLayers == 0 || header.inputSize == 0 ||
+        size < sizeof(header) + header.numLayers * sizeof(uint32_t))
+    {
+        throw std::runtime_error("Invalid model topology: " + filename);
+    }
+
+    const uint64_t maxSize = static_cast<uint64_t>(std::numeric_limits<int>::max());
+    if (header.inputSize > maxSize)
+    {
+        throw std::runtime_error("Invalid model topology: " + filename);
+    }
+
+    // Every block must fit in the file, which also keeps ModelLayout's
+    // offsets from overflowing.
+    const uint64_t weightBytes = modelScalarBytes(header.scalarType);
+    const uint64_t biasBytes = header.scalarType == MODEL_SCALAR_INT8 ? sizeof(float) : weightBytes;
+    const uint64_t scaleBytes = header.scalarType == MODEL_SCALAR_INT8 ? sizeof(float) : 0;
+    uint64_t blockBytes = 0;
+    uint64_t previousSize = header.inputSize;
+    std::vector<int> sizes(header.numLayers);
+    for (uint32_t i = 0; i < header.numLayers; i++)
+    {
+        uint32_t layerSize;
+        std::memcpy(&layerSize, image + sizeof(header) + i * sizeof(uint32_t), sizeof(layerSize));
+        if (layerSize == 0 || layerSize > maxSize)
+        {
+            throw std::runtime_error("Invalid model topology: " + filename);
+        }
+        // Both factors are below 2^31, so the product can't overflow.
+        const uint64_t weights = static_cast<uint64_t>(layerSize) * previousSize;
+        if (weights > size / weightBytes)
+        {
+            throw std::runtime_error("Model file is truncated or corrupt: " + filename);
+        }
+        blockBytes += weights * weightBytes + layerSize * (biasBytes + scaleBytes);
+        if (blockBytes > size)
+        {
+            throw std::runtime_error("Model file is truncated or corrupt: " + filename);
+        }
+        sizes[i] = static_cast<int>(layerSize);
+        previousSize = layerSize;
+    }
+
+    ModelLayout layout(static_cast<int>(header.inputSize), sizes, header.scalarType);
+    if (header.dataOffset != modelDataOffset(sizes.size()) || header.dataSize != layout.dataSize ||
+        size < header.dataOffset + header.dataSize)
+    {
+        throw std::runtime_error("Model file is truncated or corrupt: " + filename);
+    }
+
+    const unsigned char *data = image + header.dataOffset;
+    if (header.scalarType == MODEL_SCALAR_FLOAT64 && mapping)
+    {
+        // Zero-copy: the layers point straight into the mapped file.
+        m_Layers->storage.resize(0);
+        m_Layers->bind((*mapping)->data() + header.dataOffset, static_cast<int>(header.inputSize), sizes);
+        m_Layers->mapping = std::move(*mapping);
+    }
+    else
+    {
+        m_Layers->allocate(static_cast<int>(header.inputSize), sizes);
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            decodeLayer(data, header.scalarType, layout, i, m_Layers->dense[i]);
+        }
+    }
+    m_Layers->learningRate = header.learningRate;
+    return header.dataOffset + header.dataSize;
 }
 
-// Load a saved network model from a file.
-void MLP::loadModel(const std::string &filename)
+// Checkpoints are read into memory rather than mapped: the checkpoint writer
+// replaces the file while training continues from it.
+MLP::TrainingProgress MLP::loadCheckpoint(const std::string &filename)
 {
     std::ifstream ifs(filename, std::ios::binary);
     if (!ifs)
     {
-        throw std::runtime_error("Unable to open file for loading: " + filename);
+        throw std::runtime_error("Unable to open checkpoint: " + filename);
+    }
+    std::vector<unsigned char> image((std::istreambuf_iterator<char>(ifs)),
+                                     std::istreambuf_iterator<char>());
+    if (image.size() < sizeof(MODEL_MAGIC) || std::memcmp(image.data(), MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0)
+    {
+        throw std::runtime_error("Not a training checkpoint: " + filename);
+    }
+
+    size_t pos = loadModelImage(image.data(), image.size(), filename, nullptr);
+    TrainingStateHeader state;
+    if (image.size() - pos < sizeof(state))
+    {
+        throw std::runtime_error("Checkpoint holds no training state: " + filename);
+    }
+    std::memcpy(&state, image.data() + pos, sizeof(state));
+    pos += sizeof(state);
+    if (std::memcmp(state.magic, TRAINING_STATE_MAGIC, sizeof(state.magic)) != 0 ||
+        state.version != TRAINING_STATE_VERSION || state.nextEpoch < 0 ||
+        image.size() - pos < state.bestModelSize)
+    {
+        throw std::runtime_error("Invalid training state in checkpoint: " + filename);
+    }
+
+    TrainingProgress progress;
+    progress.nextEpoch = state.nextEpoch;
+    progress.epochsWithoutImprovement = state.epochsWithoutImprovement;
+    progress.bestAccuracy = state.bestAccuracy;
+    progress.bestModelAccuracy = state.bestModelAccuracy;
+    progress.bestEpoch = state.bestEpoch;
+    progress.seed = state.seed;
+    if (state.bestModelSize > 0)
+    {
+        progress.bestModel = std::make_shared<const std::vector<unsigned char>>(
+            image.begin() + pos, image.begin() + pos + state.bestModelSize);
+    }
+    return progress;
+}
+
+// A layer read from a legacy model file.
+struct LegacyLayer
+{
+    int inputs = 0;
+    std::vector<double> weights;
+    std::vector<double> biases;
+    double learningRate = 0.0;
+};
+
+// Parse the header-less per-perceptron stream. Every layer is a neuron count
+// followed by one record per neuron (weight count, weights, bias, learning
+// rate). Multi-layer files start with the number of hidden layers; the
+// earliest files hold exactly one hidden layer and omit that count. Returns
+// false unless the layout is consistent and covers the whole file.
+static bool parseLegacyLayers(const unsigned char *data, size_t size, bool hasLayerCount,
+                              std::vector<LegacyLayer> &layers)
+{
+    size_t pos = 0;
+    auto readValue = [&](auto &value) -> bool
+    {
+        if (size - pos < sizeof(value))
+        {
+            return false;
+        }
+        std::memcpy(&value, data + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    };
+
+    uint64_t numHiddenLayers = 1;
+    if (hasLayerCount && (!readValue(numHiddenLayers) || numHiddenLayers > 1024))
+    {
+        return false;
     }
 
-    // Load hidden layers.
-    size_t numHiddenLayers;
-    ifs.read(reinterpret_cast<char *>(&numHiddenLayers),
-             sizeof(numHiddenLayers));
-    m_Layers->hiddenLayers.resize(numHiddenLayers);
-    for (size_t i = 0; i < numHiddenLayers; i++)
+    layers.assign(numHiddenLayers + 1, LegacyLayer());
+    uint64_t previousSize = 0;
+    for (LegacyLayer &layer : layers)
     {
-        size_t layerSize;
-        ifs.read(reinterpret_cast<char *>(&layerSize), sizeof(layerSize));
-        m_Layers->hiddenLayers[i].resize(layerSize);
-        for (size_t j = 0; j < layerSize; j++)
+        uint64_t layerSize;
+        if (!readValue(layerSize) || layerSize == 0 || layerSize > size / (4 * sizeof(uint64_t)))
+        {
+            return false;
+        }
+        layer.biases.resize(layerSize);
+        for (uint64_t i = 0; i < layerSize; i++)
         {
-            m_Layers->hiddenLayers[i][j].load(ifs);
+            uint64_t numWeights;
+            if (!readValue(numWeights) || numWeights == 0 || numWeights > (size - pos) / sizeof(double))
+            {
+                return false;
+            }
+            if (previousSize == 0)
+            {
+                previousSize = numWeights;
+            }
+            if (numWeights != previousSize || numWeights > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+            {
+                return false;
+            }
+            if (i == 0)
+            {
+                layer.inputs = static_cast<int>(numWeights);
+                layer.weights.resize(layerSize * numWeights);
+            }
+            std::memcpy(layer.weights.data() + i * numWeights, data + pos, numWeights * sizeof(double));
+            pos += numWeights * sizeof(double);
+            if (!readValue(layer.biases[i]) || !readValue(layer.learningRate))
+            {
+                return false;
+            }
         }
+        previousSize = layerSize;
+    }
+    return pos == size;
+}
+
+// Load a header-less model file written by an earlier version of saveModel.
+void MLP::loadLegacyModel(const std::string &filename)
+{
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs)
+    {
+        throw std::runtime_error("Unable to open file for loading: " + filename);
+    }
+    std::vector<unsigned char> contents((std::istreambuf_iterator<char>(ifs)),
+                                        std::istreambuf_iterator<char>());
+
+    std::vector<LegacyLayer> layers;
+    if (!parseLegacyLayers(contents.data(), contents.size(), true, layers) &&
+        !parseLegacyLayers(contents.data(), contents.size(), false, layers))
+    {
+        throw std::runtime_error("Unrecognised or corrupt model file: " + filename);
     }
 
-    // Load outer (output) layer.
-    size_t outerSize;
-    ifs.read(reinterpret_cast<char *>(&outerSize), sizeof(outerSize));
-    m_Layers->outerLayer.resize(outerSize);
-    for (size_t i = 0; i < outerSize; i++)
+    std::vector<int> sizes;
+    for (const LegacyLayer &layer : layers)
+    {
+        sizes.push_back(static_cast<int>(layer.biases.size()));
+    }
+    m_Layers->allocate(layers.front().inputs, sizes);
+    for (size_t i = 0; i < layers.size(); i++)
     {
-        m_Layers->outerLayer[i].load(ifs);
+        DenseLayer &dense = m_Layers->dense[i];
+        std::copy(layers[i].weights.begin(), layers[i].weights.end(), dense.weights);
+        std::copy(layers[i].biases.begin(), layers[i].biases.end(), dense.biases);
     }
-    ifs.close();
+    m_Layers->learningRate = layers.back().learningRate;
 }
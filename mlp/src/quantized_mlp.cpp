@@ -0,0 +1,595 @@
+#include "../include/quantized_mlp.h"
+#include "../include/aligned_buffer.h"
+#include "../include/weight_codec.h"
+#include "../include/model_format.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#include <immintrin.h>
+#define MLP_INT8_AVX512VNNI
+#elif defined(__AVXVNNI__)
+#include <immintrin.h>
+#define MLP_INT8_AVXVNNI
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define MLP_INT8_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MLP_INT8_SSE2
+#endif
+
+// Activation value that stands for 1.0.
+static const int ACTIVATION_MAX = 127;
+
+// Weight rows and activations are zero-padded to a multiple of K_ALIGN
+// bytes, the widest vector load, so the kernels have no tail.
+static const size_t K_ALIGN = 64;
+
+// Output neurons computed together; the weights hold zero rows up to a
+// multiple of ROWS.
+static const int ROWS = 4;
+
+// The sigmoid followed by requantization into the next layer's input range
+// is a step function of z with 127 steps. It is looked up on a grid of
+// SIGMOID_CELLS cells spanning the steps and finished by moving to the
+// steps on either side of z, which for the default range takes at most one
+// move.
+static const int SIGMOID_CELLS = 1024;
+
+// Smallest input range accepted, as a share of [0, 1].
+static const double MIN_RANGE = 1e-3;
+
+// Conversion of one layer's real-valued inputs to activations:
+// value = low + q * step.
+struct InputQuantizer
+{
+    double low;
+    double step;
+
+    explicit InputQuantizer(const ActivationRange &range)
+        : low(range.low), step((range.high - range.low) / ACTIVATION_MAX) {}
+
+    uint8_t operator()(double x) const
+    {
+        double q = std::nearbyint((x - low) / step);
+        return static_cast<uint8_t>(std::min<double>(ACTIVATION_MAX, std::max(0.0, q)));
+    }
+};
+
+struct SigmoidRequantizer
+{
+    // thresholds[i] is the z at which the sigmoid crosses low + (i + 0.5) * step
+    // of the next range, so the activation is the number of thresholds at or
+    // below z. The last entry is a sentinel.
+    double thresholds[ACTIVATION_MAX + 1];
+
+    // Number of thresholds at or below the lower edge of each cell.
+    uint8_t cellStart[SIGMOID_CELLS];
+    double origin;
+    double cellsPerUnit;
+
+    explicit SigmoidRequantizer(const ActivationRange &next)
+    {
+        InputQuantizer quantizer(next);
+        for (int i = 0; i < ACTIVATION_MAX; i++)
+        {
+            double p = quantizer.low + (i + 0.5) * quantizer.step;
+            thresholds[i] = std::log(p / (1.0 - p));
+        }
+        thresholds[ACTIVATION_MAX] = std::numeric_limits<double>::infinity();
+
+        origin = thresholds[0];
+        cellsPerUnit = SIGMOID_CELLS / (thresholds[ACTIVATION_MAX - 1] - origin);
+        for (int c = 0; c < SIGMOID_CELLS; c++)
+        {
+            double edge = origin + c / cellsPerUnit;
+            cellStart[c] = static_cast<uint8_t>(std::upper_bound(thresholds, thresholds + ACTIVATION_MAX, edge) - thresholds);
+        }
+    }
+
+    uint8_t operator()(double z) const
+    {
+        double cell = std::min(std::max((z - origin) * cellsPerUnit, 0.0), SIGMOID_CELLS - 1.0);
+        int q = cellStart[static_cast<int>(cell)];
+        while (z >= thresholds[q])
+        {
+            q++;
+        }
+        while (q > 0 && z < thresholds[q - 1])
+        {
+            q--;
+        }
+        return static_cast<uint8_t>(q);
+    }
+};
+
+// A dense layer with int8 weights on quantized inputs. The real-valued
+// output is sums[j] * rescale[j] + biases[j], where rescale folds the weight
+// scale and the input step, and biases include the low end of the inputs.
+struct QuantizedLayer
+{
+    int inputs;
+    int outputs;
+    size_t stride;     // inputs rounded up to K_ALIGN
+    int paddedOutputs; // outputs rounded up to ROWS
+    AlignedBuffer<int8_t> weights;
+    std::vector<double> rescale;
+    std::vector<double> biases;
+
+    // Hidden layers only: sigmoid into the next layer's activations.
+    std::unique_ptr<SigmoidRequantizer> requantize;
+};
+
+struct QuantizedMLP::Layers
+{
+    std::vector<QuantizedLayer> dense;
+    std::vector<ActivationRange> ranges;
+
+    // Raw pixel value to first-layer activation.
+    uint8_t pixelToActivation[256];
+};
+
+// Per-thread scratch space: activations of the current and next layer,
+// and the int32 sums and real outputs of a layer.
+struct QuantizedScratch
+{
+    AlignedBuffer<uint8_t> activations[2];
+    std::vector<int32_t> sums;
+    std::vector<double> outputs;
+};
+
+static QuantizedScratch &threadScratch()
+{
+    thread_local QuantizedScratch scratch;
+    return scratch;
+}
+
+#if defined(MLP_INT8_SSE2) || defined(MLP_INT8_AVX2) || defined(MLP_INT8_AVXVNNI)
+// Horizontal sums of four vectors of int32, as one vector.
+static __m128i sumLanes(__m128i s0, __m128i s1, __m128i s2, __m128i s3)
+{
+    __m128i s01 = _mm_add_epi32(_mm_unpacklo_epi32(s0, s1), _mm_unpackhi_epi32(s0, s1));
+    __m128i s23 = _mm_add_epi32(_mm_unpacklo_epi32(s2, s3), _mm_unpackhi_epi32(s2, s3));
+    return _mm_add_epi32(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+}
+#endif
+
+#if defined(MLP_INT8_AVX2) || defined(MLP_INT8_AVXVNNI)
+static __m128i foldHalves(__m256i v)
+{
+    return _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+// Add the products of 32 unsigned activations and signed weights to the int32 lanes of sum.
+static inline __m256i multiplyAdd(__m256i sum, __m256i activations, __m256i weights)
+{
+#if defined(MLP_INT8_AVXVNNI)
+    return _mm256_dpbusd_avx_epi32(sum, activations, weights);
+#else
+    // Pairs of products are summed in int16; with activations below 128
+    // they stay under 2 * 127 * 127 and cannot saturate.
+    const __m256i ones = _mm256_set1_epi16(1);
+    return _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(activations, weights), ones));
+#endif
+}
+#endif
+
+// Dot products of `length` activations with ROWS consecutive weight rows
+// (stride `length`). length is a multiple of K_ALIGN and both arrays are
+// aligned to it.
+static void dotRows(const uint8_t *activations, const int8_t *weights, size_t length, int32_t sums[ROWS])
+{
+#if defined(MLP_INT8_AVX512VNNI)
+    __m512i acc[ROWS];
+    for (int r = 0; r < ROWS; r++)
+    {
+        acc[r] = _mm512_setzero_si512();
+    }
+    for (size_t k = 0; k < length; k += 64)
+    {
+        const __m512i a = _mm512_load_si512(activations + k);
+        for (int r = 0; r < ROWS; r++)
+        {
+            acc[r] = _mm512_dpbusd_epi32(acc[r], a, _mm512_load_si512(weights + r * length + k));
+        }
+    }
+    for (int r = 0; r < ROWS; r++)
+    {
+        sums[r] = _mm512_reduce_add_epi32(acc[r]);
+    }
+#elif defined(MLP_INT8_AVX2) || defined(MLP_INT8_AVXVNNI)
+    __m256i acc[ROWS];
+    for (int r = 0; r < ROWS; r++)
+    {
+        acc[r] = _mm256_setzero_si256();
+    }
+    for (size_t k = 0; k < length; k += 32)
+    {
+        const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(activations + k));
+        for (int r = 0; r < ROWS; r++)
+        {
+            acc[r] = multiplyAdd(acc[r], a, _mm256_load_si256(reinterpret_cast<const __m256i *>(weights + r * length + k)));
+        }
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sums),
+                     sumLanes(foldHalves(acc[0]), foldHalves(acc[1]), foldHalves(acc[2]), foldHalves(acc[3])));
+#elif defined(MLP_INT8_SSE2)
+    // No byte multiply: both operands are widened to int16 for _mm_madd_epi16.
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc[ROWS];
+    for (int r = 0; r < ROWS; r++)
+    {
+        acc[r] = zero;
+    }
+    for (size_t k = 0; k < length; k += 16)
+    {
+        const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(activations + k));
+        const __m128i aLow = _mm_unpacklo_epi8(a, zero);
+        const __m128i aHigh = _mm_unpackhi_epi8(a, zero);
+        for (int r = 0; r < ROWS; r++)
+        {
+            const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(weights + r * length + k));
+            const __m128i wLow = _mm_srai_epi16(_mm_unpacklo_epi8(w, w), 8);
+            const __m128i wHigh = _mm_srai_epi16(_mm_unpackhi_epi8(w, w), 8);
+            acc[r] = _mm_add_epi32(acc[r], _mm_add_epi32(_mm_madd_epi16(aLow, wLow), _mm_madd_epi16(aHigh, wHigh)));
+        }
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), sumLanes(acc[0], acc[1], acc[2], acc[3]));
+#else
+    for (int r = 0; r < ROWS; r++)
+    {
+        const int8_t *row = weights + r * length;
+        int32_t sum = 0;
+        for (size_t k = 0; k < length; k++)
+        {
+            sum += static_cast<int32_t>(activations[k]) * row[k];
+        }
+        sums[r] = sum;
+    }
+#endif
+}
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+static void reserveScratch(QuantizedScratch &scratch, const std::vector<QuantizedLayer> &layers)
+{
+    size_t width = 0;
+    size_t outputs = 0;
+    for (const QuantizedLayer &layer : layers)
+    {
+        width = std::max(width, layer.stride);
+        outputs = std::max(outputs, static_cast<size_t>(layer.paddedOutputs));
+    }
+    for (AlignedBuffer<uint8_t> &buffer : scratch.activations)
+    {
+        if (buffer.size() < width)
+        {
+            buffer.resize(width);
+        }
+    }
+    if (scratch.sums.size() < outputs)
+    {
+        scratch.sums.resize(outputs);
+        scratch.outputs.resize(outputs);
+    }
+}
+
+// Run the network on activations[0], which holds the quantized input row
+// padded with zeros. Returns the real-valued outputs of the last layer.
+static const double *forwardRow(const std::vector<QuantizedLayer> &layers, QuantizedScratch &scratch)
+{
+    int current = 0;
+    const size_t last = layers.size() - 1;
+    for (size_t l = 0; l <= last; l++)
+    {
+        const QuantizedLayer &layer = layers[l];
+        const uint8_t *in = scratch.activations[current].data();
+        for (int j = 0; j < layer.paddedOutputs; j += ROWS)
+        {
+            dotRows(in, layer.weights.data() + j * layer.stride, layer.stride, scratch.sums.data() + j);
+        }
+
+        double *z = scratch.outputs.data();
+        for (int j = 0; j < layer.outputs; j++)
+        {
+            z[j] = scratch.sums[j] * layer.rescale[j] + layer.biases[j];
+        }
+        if (l == last)
+        {
+            return z;
+        }
+
+        // Sigmoid and requantization in one step.
+        uint8_t *out = scratch.activations[1 - current].data();
+        const size_t nextStride = layers[l + 1].stride;
+        for (int j = 0; j < layer.outputs; j++)
+        {
+            out[j] = (*layer.requantize)(z[j]);
+        }
+        std::memset(out + layer.outputs, 0, nextStride - layer.outputs);
+        current = 1 - current;
+    }
+    return nullptr;
+}
+
+static void softmaxRow(const double *in, int n, double *out)
+{
+    double maxVal = *std::max_element(in, in + n);
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        out[i] = std::exp(in[i] - maxVal);
+        sum += out[i];
+    }
+    for (int i = 0; i < n; i++)
+    {
+        out[i] /= sum;
+    }
+}
+
+QuantizedMLP::QuantizedMLP(const MLP &mlp, const std::vector<ActivationRange> &ranges)
+{
+    const int numLayers = mlp.numLayers();
+    if (numLayers == 0)
+    {
+        throw std::invalid_argument("Cannot quantize an empty network");
+    }
+    if (!ranges.empty() && static_cast<int>(ranges.size()) != numLayers)
+    {
+        throw std::invalid_argument("Expected one activation range per layer");
+    }
+    for (const ActivationRange &range : ranges)
+    {
+        if (!(range.low >= 0.0 && range.high <= 1.0 && range.high - range.low >= MIN_RANGE))
+        {
+            throw std::invalid_argument("Activation ranges must lie in [0, 1] and not be empty");
+        }
+    }
+
+    m_Layers = new Layers();
+    m_Layers->ranges = ranges.empty() ? std::vector<ActivationRange>(numLayers) : ranges;
+    InputQuantizer pixelQuantizer(m_Layers->ranges.front());
+    for (int p = 0; p < 256; p++)
+    {
+        m_Layers->pixelToActivation[p] = pixelQuantizer(p / 255.0);
+    }
+
+    std::vector<int8_t> row;
+    for (int l = 0; l < numLayers; l++)
+    {
+        LayerParameters source = mlp.layer(l);
+        InputQuantizer input(m_Layers->ranges[l]);
+        QuantizedLayer layer;
+        layer.inputs = source.inputs;
+        layer.outputs = source.outputs;
+        layer.stride = roundUp(source.inputs, K_ALIGN);
+        layer.paddedOutputs = static_cast<int>(roundUp(source.outputs, ROWS));
+        layer.weights.resize(layer.paddedOutputs * layer.stride);
+        layer.weights.fill(0);
+        layer.rescale.resize(source.outputs);
+        layer.biases.resize(source.outputs);
+
+        // sum_k w[k] * (low + q[k] * step) = low * sum_k w[k] + step * sum_k w[k] * q[k]
+        row.resize(source.inputs);
+        for (int j = 0; j < source.outputs; j++)
+        {
+            double scale = encodeInt8Row(source.weights + static_cast<size_t>(j) * source.inputs, source.inputs, row.data());
+            std::copy(row.begin(), row.end(), layer.weights.data() + j * layer.stride);
+            int64_t rowSum = 0;
+            for (int8_t w : row)
+            {
+                rowSum += w;
+            }
+            layer.rescale[j] = scale * input.step;
+            layer.biases[j] = source.biases[j] + input.low * scale * static_cast<double>(rowSum);
+        }
+        if (l + 1 < numLayers)
+        {
+            layer.requantize.reset(new SigmoidRequantizer(m_Layers->ranges[l + 1]));
+        }
+        m_Layers->dense.push_back(std::move(layer));
+    }
+}
+
+// Activation ranges stored after the model data, or none.
+static std::vector<ActivationRange> readCalibration(const std::string &filename, int numLayers)
+{
+    std::ifstream file(filename, std::ios::binary);
+    ModelFileHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, MODEL_MAGIC, sizeof(header.magic)) != 0)
+    {
+        return {}; // legacy files carry no ranges
+    }
+    file.seekg(static_cast<std::streamoff>(header.dataOffset + header.dataSize));
+    CalibrationHeader calibration;
+    if (!file.read(reinterpret_cast<char *>(&calibration), sizeof(calibration)) ||
+        std::memcmp(calibration.magic, CALIBRATION_MAGIC, sizeof(calibration.magic)) != 0)
+    {
+        return {};
+    }
+    if (calibration.version != CALIBRATION_VERSION || static_cast<int>(calibration.numLayers) != numLayers)
+    {
+        throw std::runtime_error("Unsupported calibration data in model file: " + filename);
+    }
+
+    std::vector<ActivationRange> ranges(numLayers);
+    for (ActivationRange &range : ranges)
+    {
+        double bounds[2];
+        if (!file.read(reinterpret_cast<char *>(bounds), sizeof(bounds)))
+        {
+            throw std::runtime_error("Truncated calibration data in model file: " + filename);
+        }
+        range.low = bounds[0];
+        range.high = bounds[1];
+    }
+    return ranges;
+}
+
+QuantizedMLP QuantizedMLP::fromFile(const std::string &filename)
+{
+    MLP mlp = MLP::fromFile(filename);
+    return QuantizedMLP(mlp, readCalibration(filename, mlp.numLayers()));
+}
+
+void QuantizedMLP::saveCalibrated(const MLP &mlp, const std::vector<ActivationRange> &ranges,
+                                  const std::string &filename)
+{
+    if (static_cast<int>(ranges.size()) != mlp.numLayers())
+    {
+        throw std::invalid_argument("Expected one activation range per layer");
+    }
+    mlp.saveModel(filename, MODEL_SCALAR_INT8);
+
+    std::ofstream ofs(filename, std::ios::binary | std::ios::app);
+    CalibrationHeader header = {};
+    std::memcpy(header.magic, CALIBRATION_MAGIC, sizeof(header.magic));
+    header.version = CALIBRATION_VERSION;
+    header.numLayers = static_cast<uint32_t>(ranges.size());
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const ActivationRange &range : ranges)
+    {
+        double bounds[2] = {range.low, range.high};
+        ofs.write(reinterpret_cast<const char *>(bounds), sizeof(bounds));
+    }
+    if (!ofs)
+    {
+        throw std::runtime_error("Failed to write model file: " + filename);
+    }
+}
+
+QuantizedMLP::QuantizedMLP(QuantizedMLP &&other) noexcept
+    : m_Layers(other.m_Layers)
+{
+    other.m_Layers = nullptr;
+}
+
+QuantizedMLP &QuantizedMLP::operator=(QuantizedMLP &&other) noexcept
+{
+    if (this != &other)
+    {
+        delete m_Layers;
+        m_Layers = other.m_Layers;
+        other.m_Layers = nullptr;
+    }
+    return *this;
+}
+
+QuantizedMLP::~QuantizedMLP()
+{
+    delete m_Layers;
+}
+
+int QuantizedMLP::inputSize() const
+{
+    return m_Layers->dense.front().inputs;
+}
+
+int QuantizedMLP::outputSize() const
+{
+    return m_Layers->dense.back().outputs;
+}
+
+const std::vector<ActivationRange> &QuantizedMLP::ranges() const
+{
+    return m_Layers->ranges;
+}
+
+std::vector<double> QuantizedMLP::forward(const std::vector<double> &inputs) const
+{
+    const QuantizedLayer &first = m_Layers->dense.front();
+    if (static_cast<int>(inputs.size()) != first.inputs)
+    {
+        throw std::invalid_argument("Input size does not match the network");
+    }
+    QuantizedScratch &scratch = threadScratch();
+    reserveScratch(scratch, m_Layers->dense);
+
+    InputQuantizer quantize(m_Layers->ranges.front());
+    uint8_t *in = scratch.activations[0].data();
+    for (int k = 0; k < first.inputs; k++)
+    {
+        in[k] = quantize(inputs[k]);
+    }
+    std::memset(in + first.inputs, 0, first.stride - first.inputs);
+
+    std::vector<double> probabilities(outputSize());
+    softmaxRow(forwardRow(m_Layers->dense, scratch), outputSize(), probabilities.data());
+    return probabilities;
+}
+
+// Quantize each row of pixels into the scratch input and pass the output
+// layer's values to emit(row, values).
+template <typename Emit>
+static void forwardPixels(const std::vector<QuantizedLayer> &layers, const uint8_t *pixelToActivation,
+                          const unsigned char *pixels, size_t count, Emit emit)
+{
+    QuantizedScratch &scratch = threadScratch();
+    reserveScratch(scratch, layers);
+
+    const QuantizedLayer &first = layers.front();
+    uint8_t *in = scratch.activations[0].data();
+    for (size_t i = 0; i < count; i++)
+    {
+        // The layers alternate between both buffers, so the padding is reset every row.
+        const unsigned char *row = pixels + i * first.inputs;
+        for (int k = 0; k < first.inputs; k++)
+        {
+            in[k] = pixelToActivation[row[k]];
+        }
+        std::memset(in + first.inputs, 0, first.stride - first.inputs);
+        emit(i, forwardRow(layers, scratch));
+    }
+}
+
+void QuantizedMLP::forwardBatch(const unsigned char *pixels, size_t count, double *probabilities) const
+{
+    const int n = outputSize();
+    forwardPixels(m_Layers->dense, m_Layers->pixelToActivation, pixels, count, [&](size_t i, const double *z)
+                  { softmaxRow(z, n, probabilities + i * n); });
+}
+
+// Softmax keeps the order of the outputs, so the class is read off the raw values.
+void QuantizedMLP::forwardBatch(const unsigned char *pixels, size_t count, int *classes) const
+{
+    const int n = outputSize();
+    forwardPixels(m_Layers->dense, m_Layers->pixelToActivation, pixels, count, [&](size_t i, const double *z)
+                  { classes[i] = static_cast<int>(std::max_element(z, z + n) - z); });
+}
+
+size_t QuantizedMLP::parameterBytes() const
+{
+    size_t bytes = 0;
+    for (const QuantizedLayer &layer : m_Layers->dense)
+    {
+        bytes += layer.weights.size() * sizeof(int8_t) +
+                 (layer.rescale.size() + layer.biases.size()) * sizeof(double);
+    }
+    return bytes;
+}
+
+const char *QuantizedMLP::kernelName()
+{
+#if defined(MLP_INT8_AVX512VNNI)
+    return "AVX-512 VNNI";
+#elif defined(MLP_INT8_AVXVNNI)
+    return "AVX-VNNI";
+#elif defined(MLP_INT8_AVX2)
+    return "AVX2";
+#elif defined(MLP_INT8_SSE2)
+    return "SSE2";
+#else
+    return "portable";
+#endif
+}
@@ -0,0 +1,370 @@
+#include "../include/sparse_mlp.h"
+#include "../include/aligned_buffer.h"
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MLP_SPARSE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MLP_SPARSE_SSE2
+#endif
+
+// Samples run through the network together by forwardBatch. Activations are
+// stored input-major, BLOCK_ROWS values per input, so one non-zero weight
+// multiplies a single aligned run of BLOCK_ROWS values.
+static const int BLOCK_ROWS = 16;
+
+// One layer in CSR form: the weights of output neuron j are
+// values[rowStart[j] .. rowStart[j + 1]), at input columns[...].
+struct SparseLayer
+{
+    int inputs;
+    int outputs;
+    std::vector<uint32_t> rowStart;
+    std::vector<uint32_t> columns;
+    std::vector<double> values;
+    std::vector<double> biases;
+};
+
+struct SparseMLP::Layers
+{
+    std::vector<SparseLayer> sparse;
+    size_t denseWeights = 0;
+};
+
+// Per-thread scratch space: the activations of the current and next layer,
+// in block or single-row layout.
+struct SparseScratch
+{
+    AlignedBuffer<double> activations[2];
+};
+
+static SparseScratch &threadScratch()
+{
+    thread_local SparseScratch scratch;
+    return scratch;
+}
+
+static void reserveScratch(SparseScratch &scratch, const std::vector<SparseLayer> &layers)
+{
+    size_t widest = static_cast<size_t>(layers.front().inputs);
+    for (const SparseLayer &layer : layers)
+    {
+        widest = std::max(widest, static_cast<size_t>(layer.outputs));
+    }
+    for (AlignedBuffer<double> &buffer : scratch.activations)
+    {
+        if (buffer.size() < widest * BLOCK_ROWS)
+        {
+            buffer.resize(widest * BLOCK_ROWS);
+        }
+    }
+}
+
+// out[j * BLOCK_ROWS + r] for every output j and block row r, from the
+// input-major block in.
+static void blockLayer(const SparseLayer &layer, const double *in, double *out)
+{
+    for (int j = 0; j < layer.outputs; j++)
+    {
+        const uint32_t first = layer.rowStart[j];
+        const uint32_t end = layer.rowStart[j + 1];
+        double *sums = out + static_cast<size_t>(j) * BLOCK_ROWS;
+#if defined(MLP_SPARSE_AVX2)
+        __m256d acc[BLOCK_ROWS / 4];
+        for (int v = 0; v < BLOCK_ROWS / 4; v++)
+        {
+            acc[v] = _mm256_set1_pd(layer.biases[j]);
+        }
+        for (uint32_t p = first; p < end; p++)
+        {
+            const __m256d w = _mm256_broadcast_sd(&layer.values[p]);
+            const double *x = in + static_cast<size_t>(layer.columns[p]) * BLOCK_ROWS;
+            for (int v = 0; v < BLOCK_ROWS / 4; v++)
+            {
+                acc[v] = _mm256_add_pd(acc[v], _mm256_mul_pd(w, _mm256_load_pd(x + 4 * v)));
+            }
+        }
+        for (int v = 0; v < BLOCK_ROWS / 4; v++)
+        {
+            _mm256_store_pd(sums + 4 * v, acc[v]);
+        }
+#elif defined(MLP_SPARSE_SSE2)
+        __m128d acc[BLOCK_ROWS / 2];
+        for (int v = 0; v < BLOCK_ROWS / 2; v++)
+        {
+            acc[v] = _mm_set1_pd(layer.biases[j]);
+        }
+        for (uint32_t p = first; p < end; p++)
+        {
+            const __m128d w = _mm_load1_pd(&layer.values[p]);
+            const double *x = in + static_cast<size_t>(layer.columns[p]) * BLOCK_ROWS;
+            for (int v = 0; v < BLOCK_ROWS / 2; v++)
+            {
+                acc[v] = _mm_add_pd(acc[v], _mm_mul_pd(w, _mm_load_pd(x + 2 * v)));
+            }
+        }
+        for (int v = 0; v < BLOCK_ROWS / 2; v++)
+        {
+            _mm_store_pd(sums + 2 * v, acc[v]);
+        }
+#else
+        for (int r = 0; r < BLOCK_ROWS; r++)
+        {
+            sums[r] = layer.biases[j];
+        }
+        for (uint32_t p = first; p < end; p++)
+        {
+            const double w = layer.values[p];
+            const double *x = in + static_cast<size_t>(layer.columns[p]) * BLOCK_ROWS;
+            for (int r = 0; r < BLOCK_ROWS; r++)
+            {
+                sums[r] += w * x[r];
+            }
+        }
+#endif
+    }
+}
+
+// Outputs of one layer for a single sample.
+static void rowLayer(const SparseLayer &layer, const double *in, double *out)
+{
+    for (int j = 0; j < layer.outputs; j++)
+    {
+        double sum = layer.biases[j];
+        for (uint32_t p = layer.rowStart[j]; p < layer.rowStart[j + 1]; p++)
+        {
+            sum += layer.values[p] * in[layer.columns[p]];
+        }
+        out[j] = sum;
+    }
+}
+
+static void sigmoid(double *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = 1.0 / (1.0 + std::exp(-values[i]));
+    }
+}
+
+// Run the layers on the input in scratch.activations[0], laid out with
+// `width` values per input (BLOCK_ROWS or 1); returns the raw outputs.
+static const double *forwardLayers(const std::vector<SparseLayer> &layers, SparseScratch &scratch, int width)
+{
+    const double *in = scratch.activations[0].data();
+    for (size_t l = 0; l < layers.size(); l++)
+    {
+        const SparseLayer &layer = layers[l];
+        double *out = scratch.activations[(l + 1) % 2].data();
+        if (width == BLOCK_ROWS)
+        {
+            blockLayer(layer, in, out);
+        }
+        else
+        {
+            rowLayer(layer, in, out);
+        }
+        // Sigmoid for the hidden layers only
+        if (l + 1 < layers.size())
+        {
+            sigmoid(out, static_cast<size_t>(layer.outputs) * width);
+        }
+        in = out;
+    }
+    return in;
+}
+
+// Softmax of one row of n values; out may equal in.
+static void softmaxRow(const double *in, int n, double *out)
+{
+    double maxVal = *std::max_element(in, in + n);
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        out[i] = std::exp(in[i] - maxVal);
+        sum += out[i];
+    }
+    for (int i = 0; i < n; i++)
+    {
+        out[i] /= sum;
+    }
+}
+
+// Pass the raw outputs of every input row to emit(row, values): full blocks
+// through the vector kernel, the remaining rows one by one.
+template <typename Emit>
+static void forwardRows(const std::vector<SparseLayer> &layers, const double *inputs, size_t count, Emit emit)
+{
+    SparseScratch &scratch = threadScratch();
+    reserveScratch(scratch, layers);
+    const int inputSize = layers.front().inputs;
+    const int n = layers.back().outputs;
+    std::vector<double> row(n);
+
+    size_t first = 0;
+    for (; first + BLOCK_ROWS <= count; first += BLOCK_ROWS)
+    {
+        double *block = scratch.activations[0].data();
+        for (int r = 0; r < BLOCK_ROWS; r++)
+        {
+            const double *sample = inputs + (first + r) * inputSize;
+            for (int k = 0; k < inputSize; k++)
+            {
+                block[static_cast<size_t>(k) * BLOCK_ROWS + r] = sample[k];
+            }
+        }
+        const double *raw = forwardLayers(layers, scratch, BLOCK_ROWS);
+        for (int r = 0; r < BLOCK_ROWS; r++)
+        {
+            for (int j = 0; j < n; j++)
+            {
+                row[j] = raw[static_cast<size_t>(j) * BLOCK_ROWS + r];
+            }
+            emit(first + r, row.data());
+        }
+    }
+    for (; first < count; first++)
+    {
+        std::copy(inputs + first * inputSize, inputs + (first + 1) * inputSize, scratch.activations[0].data());
+        emit(first, forwardLayers(layers, scratch, 1));
+    }
+}
+
+SparseMLP::SparseMLP(const MLP &mlp)
+    : m_Layers(new Layers())
+{
+    for (int l = 0; l < mlp.numLayers(); l++)
+    {
+        LayerParameters source = mlp.layer(l);
+        SparseLayer layer;
+        layer.inputs = source.inputs;
+        layer.outputs = source.outputs;
+        layer.rowStart.push_back(0);
+        for (int j = 0; j < source.outputs; j++)
+        {
+            const double *row = source.weights + static_cast<size_t>(j) * source.inputs;
+            for (int k = 0; k < source.inputs; k++)
+            {
+                if (row[k] != 0.0)
+                {
+                    layer.columns.push_back(static_cast<uint32_t>(k));
+                    layer.values.push_back(row[k]);
+                }
+            }
+            layer.rowStart.push_back(static_cast<uint32_t>(layer.values.size()));
+        }
+        layer.biases.assign(source.biases, source.biases + source.outputs);
+        m_Layers->denseWeights += static_cast<size_t>(source.inputs) * source.outputs;
+        m_Layers->sparse.push_back(std::move(layer));
+    }
+    if (m_Layers->sparse.empty())
+    {
+        delete m_Layers;
+        throw std::invalid_argument("Cannot compress an empty network");
+    }
+}
+
+SparseMLP SparseMLP::fromFile(const std::string &filename)
+{
+    return SparseMLP(MLP::fromFile(filename));
+}
+
+SparseMLP::SparseMLP(SparseMLP &&other) noexcept
+    : m_Layers(other.m_Layers)
+{
+    other.m_Layers = nullptr;
+}
+
+SparseMLP &SparseMLP::operator=(SparseMLP &&other) noexcept
+{
+    if (this != &other)
+    {
+        delete m_Layers;
+        m_Layers = other.m_Layers;
+        other.m_Layers = nullptr;
+    }
+    return *this;
+}
+
+SparseMLP::~SparseMLP()
+{
+    delete m_Layers;
+}
+
+int SparseMLP::inputSize() const
+{
+    return m_Layers->sparse.front().inputs;
+}
+
+int SparseMLP::outputSize() const
+{
+    return m_Layers->sparse.back().outputs;
+}
+
+std::vector<double> SparseMLP::forward(const std::vector<double> &inputs) const
+{
+    if (static_cast<int>(inputs.size()) != inputSize())
+    {
+        throw std::invalid_argument("Input size does not match the network");
+    }
+    std::vector<double> probabilities(outputSize());
+    forwardBatch(inputs.data(), 1, probabilities.data());
+    return probabilities;
+}
+
+void SparseMLP::forwardBatch(const double *inputs, size_t count, double *probabilities) const
+{
+    const int n = outputSize();
+    forwardRows(m_Layers->sparse, inputs, count, [&](size_t i, const double *z)
+                { softmaxRow(z, n, probabilities + i * n); });
+}
+
+// Softmax keeps the order of the outputs, so the class is read off the raw values.
+void SparseMLP::forwardBatch(const double *inputs, size_t count, int *classes) const
+{
+    const int n = outputSize();
+    forwardRows(m_Layers->sparse, inputs, count, [&](size_t i, const double *z)
+                { classes[i] = static_cast<int>(std::max_element(z, z + n) - z); });
+}
+
+size_t SparseMLP::nonZeros() const
+{
+    size_t count = 0;
+    for (const SparseLayer &layer : m_Layers->sparse)
+    {
+        count += layer.values.size();
+    }
+    return count;
+}
+
+double SparseMLP::density() const
+{
+    return static_cast<double>(nonZeros()) / m_Layers->denseWeights;
+}
+
+size_t SparseMLP::parameterBytes() const
+{
+    size_t bytes = 0;
+    for (const SparseLayer &layer : m_Layers->sparse)
+    {
+        bytes += (layer.rowStart.size() + layer.columns.size()) * sizeof(uint32_t) +
+                 (layer.values.size() + layer.biases.size()) * sizeof(double);
+    }
+    return bytes;
+}
+
+const char *SparseMLP::kernelName()
+{
+#if defined(MLP_SPARSE_AVX2)
+    return "AVX2";
+#elif defined(MLP_SPARSE_SSE2)
+    return "SSE2";
+#else
+    return "portable";
+#endif
+}
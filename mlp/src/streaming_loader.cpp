@@ -0,0 +1,331 @@
+#include "../include/streaming_loader.h"
+#include "../include/aligned_buffer.h"
+#include "../include/counter_rng.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+// Samples are pulled from the source in chunks of this many.
+static const size_t READ_CHUNK = 1024;
+
+struct StreamingSlot
+{
+    AlignedBuffer<double> inputs;
+    AlignedBuffer<double> targets;
+    size_t count = 0;
+    bool ready = false;
+};
+
+// The producer fills batch b into slot b % depth once the consumer has
+// released batch b - depth. A new epoch bumps the generation; a producer
+// still working on an older generation abandons it at the next batch.
+struct StreamingLoader::Pipeline
+{
+    SampleSource &source;
+    size_t batchSize;
+    size_t windowSize;
+    uint64_t seed;
+    BatchLoader::Augmenter augment;
+    int sampleSize;
+    int numClasses;
+
+    std::vector<StreamingSlot> slots;
+    std::thread producer;
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable batchReady;
+    std::condition_variable slotFreed;
+
+    int epoch = 0;
+    unsigned long long generation = 0;
+    bool epochRequested = false;
+    bool epochFinished = true;
+    size_t batchesProduced = 0;
+    size_t nextToServe = 0;
+    size_t released = 0;
+    bool holding = false;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    double stallSeconds = 0.0;
+    size_t batchesServed = 0;
+
+    Pipeline(SampleSource &src) : source(src) {}
+
+    void producerLoop();
+    bool produceEpoch(unsigned long long epochGeneration, int epochIndex);
+};
+
+void StreamingLoader::Pipeline::producerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        workAvailable.wait(lock, [this]
+                           { return stopping || epochRequested; });
+        if (stopping)
+        {
+            return;
+        }
+        epochRequested = false;
+        unsigned long long epochGeneration = generation;
+        int epochIndex = epoch;
+
+        lock.unlock();
+        bool completed = false;
+        std::exception_ptr failure;
+        try
+        {
+            completed = produceEpoch(epochGeneration, epochIndex);
+        }
+        catch (...)
+        {
+            failure = std::current_exception();
+        }
+        lock.lock();
+
+        if (epochGeneration == generation && (completed || failure))
+        {
+            error = failure;
+            epochFinished = true;
+            batchReady.notify_all();
+        }
+    }
+}
+
+// Produces every batch of one epoch. Returns false if the epoch was
+// superseded by a newer startEpoch call or the loader is shutting down.
+bool StreamingLoader::Pipeline::produceEpoch(unsigned long long epochGeneration, int epochIndex)
+{
+    source.rewind();
+    CounterRng rng(seed, static_cast<uint64_t>(epochIndex));
+
+    // Shuffle window plus the chunk currently being read; both are fixed size.
+    std::vector<unsigned char> windowPixels(windowSize * sampleSize);
+    std::vector<unsigned char> windowLabels(windowSize);
+    std::vector<uint64_t> windowIds(windowSize);
+    std::vector<unsigned char> chunkPixels(READ_CHUNK * sampleSize);
+    std::vector<unsigned char> chunkLabels(READ_CHUNK);
+    std::vector<unsigned char> scratch(sampleSize);
+    size_t chunkCount = 0;
+    size_t chunkPos = 0;
+    uint64_t streamPosition = 0;
+    bool sourceDone = false;
+
+    // Pull the next sample of the pass into window slot `slot`.
+    auto pull = [&](size_t slot) -> bool
+    {
+        if (chunkPos == chunkCount && !sourceDone)
+        {
+            chunkCount = source.read(chunkPixels.data(), chunkLabels.data(), READ_CHUNK);
+            chunkPos = 0;
+            sourceDone = chunkCount == 0;
+        }
+        if (sourceDone)
+        {
+            return false;
+        }
+        if (chunkLabels[chunkPos] >= numClasses)
+        {
+            throw std::runtime_error("Label out of range in sample source.");
+        }
+        std::copy(chunkPixels.begin() + chunkPos * sampleSize,
+                  chunkPixels.begin() + (chunkPos + 1) * sampleSize,
+                  windowPixels.begin() + slot * sampleSize);
+        windowLabels[slot] = chunkLabels[chunkPos];
+        windowIds[slot] = streamPosition++;
+        chunkPos++;
+        return true;
+    };
+
+    size_t windowCount = 0;
+    while (windowCount < windowSize && pull(windowCount))
+    {
+        windowCount++;
+    }
+
+    for (size_t batchIndex = 0; windowCount > 0; batchIndex++)
+    {
+        StreamingSlot *slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFreed.wait(lock, [&]
+                           { return stopping || generation != epochGeneration ||
+                                    batchIndex < released + slots.size(); });
+            if (stopping || generation != epochGeneration)
+            {
+                return false;
+            }
+            slot = &slots[batchIndex % slots.size()];
+        }
+
+        double *inputs = slot->inputs.data();
+        double *targets = slot->targets.data();
+        size_t count = 0;
+        std::fill(targets, targets + batchSize * numClasses, 0.0);
+        while (count < batchSize && windowCount > 0)
+        {
+            // Emit a random window entry and refill its place from the source.
+            size_t pick = static_cast<size_t>(rng.below(windowCount));
+            const unsigned char *pixels = windowPixels.data() + pick * sampleSize;
+            if (augment)
+            {
+                std::copy(pixels, pixels + sampleSize, scratch.begin());
+                augment(scratch.data(), static_cast<size_t>(windowIds[pick]), epochIndex);
+                pixels = scratch.data();
+            }
+            Dataset::normalize(pixels, sampleSize, inputs + count * sampleSize);
+            targets[count * numClasses + windowLabels[pick]] = 1.0;
+            count++;
+
+            if (!pull(pick))
+            {
+                // Source exhausted: shrink the window by moving the last entry into the hole.
+                windowCount--;
+                if (pick != windowCount)
+                {
+                    std::copy(windowPixels.begin() + windowCount * sampleSize,
+                              windowPixels.begin() + (windowCount + 1) * sampleSize,
+                              windowPixels.begin() + pick * sampleSize);
+                    windowLabels[pick] = windowLabels[windowCount];
+                    windowIds[pick] = windowIds[windowCount];
+                }
+            }
+        }
+        slot->count = count;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (generation != epochGeneration)
+        {
+            return false;
+        }
+        slot->ready = true;
+        batchesProduced = batchIndex + 1;
+        batchReady.notify_all();
+    }
+    return true;
+}
+
+StreamingLoader::StreamingLoader(SampleSource &source, size_t batchSize, size_t shuffleWindow,
+                                 uint64_t seed, int prefetchDepth,
+                                 BatchLoader::Augmenter augment)
+    : m_Pipeline(new Pipeline(source))
+{
+    if (batchSize == 0 || shuffleWindow == 0 || prefetchDepth < 2 ||
+        source.sampleSize() <= 0 || source.numClasses() <= 0)
+    {
+        delete m_Pipeline;
+        throw std::invalid_argument("Invalid streaming loader configuration");
+    }
+    Pipeline &p = *m_Pipeline;
+    p.batchSize = batchSize;
+    p.windowSize = shuffleWindow;
+    p.seed = seed;
+    p.augment = augment;
+    p.sampleSize = source.sampleSize();
+    p.numClasses = source.numClasses();
+
+    p.slots.resize(prefetchDepth);
+    for (StreamingSlot &slot : p.slots)
+    {
+        slot.inputs.resize(batchSize * p.sampleSize);
+        slot.targets.resize(batchSize * p.numClasses);
+    }
+    p.producer = std::thread([this]
+                             { m_Pipeline->producerLoop(); });
+}
+
+StreamingLoader::~StreamingLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Pipeline->mutex);
+        m_Pipeline->stopping = true;
+    }
+    m_Pipeline->workAvailable.notify_all();
+    m_Pipeline->slotFreed.notify_all();
+    m_Pipeline->producer.join();
+    delete m_Pipeline;
+}
+
+void StreamingLoader::startEpoch(int epoch)
+{
+    Pipeline &p = *m_Pipeline;
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.generation++;
+    p.epoch = epoch;
+    p.epochRequested = true;
+    p.epochFinished = false;
+    p.error = nullptr;
+    p.batchesProduced = 0;
+    p.nextToServe = 0;
+    p.released = 0;
+    p.holding = false;
+    for (StreamingSlot &slot : p.slots)
+    {
+        slot.ready = false;
+    }
+    p.workAvailable.notify_all();
+    p.slotFreed.notify_all();
+}
+
+bool StreamingLoader::next(Batch &batch)
+{
+    Pipeline &p = *m_Pipeline;
+    std::unique_lock<std::mutex> lock(p.mutex);
+
+    if (p.holding)
+    {
+        p.holding = false;
+        p.released++;
+        p.slotFreed.notify_all();
+    }
+
+    StreamingSlot &slot = p.slots[p.nextToServe % p.slots.size()];
+    auto available = [&]
+    { return slot.ready || (p.epochFinished && p.nextToServe >= p.batchesProduced); };
+    if (!available())
+    {
+        auto waitStart = std::chrono::steady_clock::now();
+        p.batchReady.wait(lock, available);
+        p.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+    }
+    if (p.error)
+    {
+        std::rethrow_exception(p.error);
+    }
+    if (!slot.ready)
+    {
+        return false;
+    }
+    slot.ready = false;
+
+    batch.inputs = slot.inputs.data();
+    batch.targets = slot.targets.data();
+    batch.indices = nullptr;
+    batch.count = slot.count;
+    batch.inputSize = p.sampleSize;
+    batch.outputSize = p.numClasses;
+
+    p.nextToServe++;
+    p.holding = true;
+    p.batchesServed++;
+    return true;
+}
+
+double StreamingLoader::stallSeconds() const
+{
+    std::lock_guard<std::mutex> lock(m_Pipeline->mutex);
+    return m_Pipeline->stallSeconds;
+}
+
+size_t StreamingLoader::batchesServed() const
+{
+    std::lock_guard<std::mutex> lock(m_Pipeline->mutex);
+    return m_Pipeline->batchesServed;
+}
@@ -0,0 +1,97 @@
+#include "../include/teacher_logits.h"
+#include "../include/aligned_buffer.h"
+#include "../include/dense_kernel.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Samples run through the teacher together.
+static const size_t TEACHER_BLOCK_ROWS = 256;
+
+TeacherLogits::TeacherLogits(const MLP &teacher, const Dataset &data)
+    : m_data(&data), m_numClasses(teacher.outputSize())
+{
+    if (teacher.numLayers() == 0 || data.sampleSize() != teacher.inputSize() ||
+        data.numClasses() != teacher.outputSize())
+    {
+        throw std::invalid_argument("Dataset dimensions don't match the teacher");
+    }
+    m_logits.resize(data.size() * m_numClasses);
+
+    const int numLayers = teacher.numLayers();
+    size_t width = static_cast<size_t>(teacher.inputSize());
+    for (int l = 0; l < numLayers; l++)
+    {
+        width = std::max(width, static_cast<size_t>(teacher.layer(l).outputs));
+    }
+    AlignedBuffer<double> activations[2];
+    for (AlignedBuffer<double> &buffer : activations)
+    {
+        buffer.resize(TEACHER_BLOCK_ROWS * width);
+    }
+    std::vector<AlignedBuffer<double>> panels(numLayers);
+    for (int l = 0; l < numLayers; l++)
+    {
+        LayerParameters layer = teacher.layer(l);
+        packWeights(layer.weights, layer.inputs, layer.outputs, panels[l]);
+    }
+
+    for (size_t first = 0; first < data.size(); first += TEACHER_BLOCK_ROWS)
+    {
+        const size_t rows = std::min(TEACHER_BLOCK_ROWS, data.size() - first);
+        data.gatherRange(first, rows, activations[0].data(), nullptr);
+        const double *in = activations[0].data();
+        for (int l = 0; l < numLayers; l++)
+        {
+            LayerParameters layer = teacher.layer(l);
+            // The output layer writes straight into the cache.
+            double *out = l + 1 < numLayers ? activations[(l + 1) % 2].data()
+                                            : m_logits.data() + first * m_numClasses;
+            denseBatch(in, rows, layer.inputs, panels[l].data(), layer.biases, layer.outputs, out);
+            if (l + 1 < numLayers)
+            {
+                for (size_t i = 0; i < rows * layer.outputs; i++)
+                {
+                    out[i] = 1.0 / (1.0 + std::exp(-out[i]));
+                }
+            }
+            in = out;
+        }
+    }
+}
+
+const Dataset &TeacherLogits::dataset() const
+{
+    return *m_data;
+}
+
+size_t TeacherLogits::size() const
+{
+    return m_logits.size() / m_numClasses;
+}
+
+int TeacherLogits::numClasses() const
+{
+    return m_numClasses;
+}
+
+const double *TeacherLogits::logits(size_t index) const
+{
+    return m_logits.data() + index * m_numClasses;
+}
+
+void TeacherLogits::softTargets(size_t index, double temperature, double *probabilities) const
+{
+    const double *z = logits(index);
+    double maxVal = *std::max_element(z, z + m_numClasses);
+    double sum = 0.0;
+    for (int i = 0; i < m_numClasses; i++)
+    {
+        probabilities[i] = std::exp((z[i] - maxVal) / temperature);
+        sum += probabilities[i];
+    }
+    for (int i = 0; i < m_numClasses; i++)
+    {
+        probabilities[i] /= sum;
+    }
+}
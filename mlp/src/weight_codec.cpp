@@ -0,0 +1,258 @@
+#include "../include/weight_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MLP_CODEC_SSE2
+#endif
+
+// F16C comes with every AVX2 CPU; MSVC has no separate macro for it.
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define MLP_CODEC_F16C
+#endif
+
+static uint32_t floatBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bitsFloat(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// float -> binary16, round to nearest even. Values too large for binary16
+// become infinity, values too small become subnormals or zero.
+static uint16_t floatToHalf(float value)
+{
+    const uint32_t f32Infinity = 255u << 23;
+    const uint32_t f16Max = (127u + 16u) << 23;
+    const uint32_t denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t bits = floatBits(value);
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint16_t half;
+    if (bits >= f16Max)
+    {
+        half = bits > f32Infinity ? 0x7E00 : 0x7C00;
+    }
+    else if (bits < (113u << 23))
+    {
+        // Subnormal result: let the FPU do the rounding.
+        half = static_cast<uint16_t>(floatBits(bitsFloat(bits) + bitsFloat(denormMagic)) - denormMagic);
+    }
+    else
+    {
+        uint32_t mantissaOdd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xFFF;
+        bits += mantissaOdd;
+        half = static_cast<uint16_t>(bits >> 13);
+    }
+    return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+static float halfToFloat(uint16_t half)
+{
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+
+    if (exponent == 0x1F)
+    {
+        return bitsFloat(sign | 0x7F800000u | (mantissa << 13));
+    }
+    if (exponent == 0)
+    {
+        // Zero or subnormal: mantissa * 2^-24.
+        float magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        return sign ? -magnitude : magnitude;
+    }
+    return bitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+void encodeFloat32(const double *values, size_t count, float *out)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = static_cast<float>(values[i]);
+    }
+}
+
+void decodeFloat32(const float *in, size_t count, double *out)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm_loadu_ps(in + i)));
+    }
+#elif defined(MLP_CODEC_SSE2)
+    for (; i + 2 <= count; i += 2)
+    {
+        _mm_storeu_pd(out + i, _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(in + i)))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = in[i];
+    }
+}
+
+void encodeFloat16(const double *values, size_t count, uint16_t *out)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = floatToHalf(static_cast<float>(values[i]));
+    }
+}
+
+void decodeFloat16(const uint16_t *in, size_t count, double *out)
+{
+    size_t i = 0;
+#if defined(MLP_CODEC_F16C)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 floats = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(floats)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(floats, 1)));
+    }
+#elif defined(__AVX2__) || defined(MLP_CODEC_SSE2)
+    // Move exponent and mantissa into float position and rebias the
+    // exponent; infinities/NaNs get the rest of the exponent range and
+    // subnormals are renormalized by subtracting 2^-14.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i magnitudeMask = _mm_set1_epi32(0x7FFF);
+    const __m128i signMask = _mm_set1_epi32(0x8000);
+    const __m128i shiftedExponent = _mm_set1_epi32(0x7C00 << 13);
+    const __m128i exponentBias = _mm_set1_epi32((127 - 15) << 23);
+    const __m128i infinityAdjust = _mm_set1_epi32((128 - 16) << 23);
+    const __m128i subnormalAdjust = _mm_set1_epi32(1 << 23);
+    const __m128 subnormalMagic = _mm_castsi128_ps(_mm_set1_epi32(113 << 23));
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i halves = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i)), zero);
+        __m128i bits = _mm_slli_epi32(_mm_and_si128(halves, magnitudeMask), 13);
+        __m128i exponent = _mm_and_si128(bits, shiftedExponent);
+        bits = _mm_add_epi32(bits, exponentBias);
+        bits = _mm_add_epi32(bits, _mm_and_si128(_mm_cmpeq_epi32(exponent, shiftedExponent), infinityAdjust));
+        __m128i isSubnormal = _mm_cmpeq_epi32(exponent, zero);
+        __m128i renormalized = _mm_castps_si128(
+            _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, subnormalAdjust)), subnormalMagic));
+        bits = _mm_or_si128(_mm_and_si128(isSubnormal, renormalized), _mm_andnot_si128(isSubnormal, bits));
+        bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(halves, signMask), 16));
+
+        __m128 floats = _mm_castsi128_ps(bits);
+        _mm_storeu_pd(out + i, _mm_cvtps_pd(floats));
+        _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(floats, floats)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = halfToFloat(in[i]);
+    }
+}
+
+void encodeBFloat16(const double *values, size_t count, uint16_t *out)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t bits = floatBits(static_cast<float>(values[i]));
+        if ((bits & 0x7FFFFFFFu) > 0x7F800000u)
+        {
+            out[i] = static_cast<uint16_t>((bits >> 16) | 0x40); // keep NaNs quiet
+            continue;
+        }
+        bits += 0x7FFF + ((bits >> 16) & 1);
+        out[i] = static_cast<uint16_t>(bits >> 16);
+    }
+}
+
+void decodeBFloat16(const uint16_t *in, size_t count, double *out)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        __m256 floats = _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(floats)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(floats, 1)));
+    }
+#elif defined(MLP_CODEC_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4)
+    {
+        // Interleaving zeros below each value shifts it into the upper half.
+        __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i));
+        __m128 floats = _mm_castsi128_ps(_mm_unpacklo_epi16(zero, raw));
+        _mm_storeu_pd(out + i, _mm_cvtps_pd(floats));
+        _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(floats, floats)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = bitsFloat(static_cast<uint32_t>(in[i]) << 16);
+    }
+}
+
+float encodeInt8Row(const double *values, size_t count, int8_t *out)
+{
+    double maxAbs = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        maxAbs = std::max(maxAbs, std::abs(values[i]));
+    }
+    float scale = static_cast<float>(maxAbs / 127.0);
+    if (scale == 0.0f)
+    {
+        std::fill(out, out + count, static_cast<int8_t>(0));
+        return 0.0f;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        double q = std::nearbyint(values[i] / scale);
+        out[i] = static_cast<int8_t>(std::min(127.0, std::max(-127.0, q)));
+    }
+    return scale;
+}
+
+void decodeInt8Row(const int8_t *in, size_t count, float scale, double *out)
+{
+    const double factor = scale;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256d factorV = _mm256_set1_pd(factor);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i ints = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i)));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(ints)), factorV));
+        _mm256_storeu_pd(out + i + 4, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(ints, 1)), factorV));
+    }
+#elif defined(MLP_CODEC_SSE2)
+    const __m128d factorV = _mm_set1_pd(factor);
+    for (; i + 4 <= count; i += 4)
+    {
+        // Sign-extend four bytes to int32 by moving each into the top byte.
+        int32_t packed;
+        std::memcpy(&packed, in + i, sizeof(packed));
+        __m128i bytes = _mm_cvtsi32_si128(packed);
+        __m128i ints = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), _mm_unpacklo_epi8(_mm_setzero_si128(), bytes)), 24);
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_cvtepi32_pd(ints), factorV));
+        _mm_storeu_pd(out + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(ints, 0xEE)), factorV));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = in[i] * factor;
+    }
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../mlp/include/mlp.h"
+
+// Writes a trained network as a self-contained C++17 header: the parameters
+// as constexpr arrays and inline forward functions specialized for the
+// topology. The header needs only <cmath>, so a program that includes it does
+// no file I/O, parsing or allocation to get a model.
+//
+// The weights are stored transposed and the forward pass is the one of
+// StaticMLP, with the same order of operations as MLP; every literal reads
+// back as exactly the stored double. Predictions and probabilities therefore
+// equal those of MLP::forward, unless the compiler fuses multiplies and adds.
+class HeaderExporter
+{
+public:
+    // Values written per line of an array.
+    static const int VALUES_PER_LINE = 6;
+
+    /**
+     * @param mlp Network to export.
+     * @param sourceName Model file the network came from, for the header comment.
+     * @param namespaceName Namespace of the generated arrays and functions.
+     */
+    HeaderExporter(const MLP &mlp, const std::string &sourceName, const std::string &namespaceName)
+        : m_mlp(mlp), m_sourceName(sourceName), m_namespace(namespaceName)
+    {
+        if (!isIdentifier(namespaceName))
+        {
+            throw std::invalid_argument("Not a valid C++ namespace name: " + namespaceName);
+        }
+    }
+
+    void write(const std::string &outputPath) const
+    {
+        std::ofstream file(outputPath, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open " + outputPath + " for writing");
+        }
+        file << generate();
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write " + outputPath);
+        }
+    }
+
+    std::string generate() const
+    {
+        const int numLayers = m_mlp.numLayers();
+        std::ostringstream out;
+        out << "// Generated by model_converter from " << m_sourceName << ". Do not edit.\n"
+            << "//\n"
+            << "// Topology " << topology() << ": sigmoid hidden layers, softmax outputs.\n"
+            << "// Weights are transposed, one row of a layer's outputs per input.\n"
+            << "#pragma once\n"
+            << "\n"
+            << "#include <cmath>\n"
+            << "\n"
+            << "namespace " << m_namespace << "\n"
+            << "{\n"
+            << "\n"
+            << "constexpr int INPUT_SIZE = " << m_mlp.inputSize() << ";\n"
+            << "constexpr int OUTPUT_SIZE = " << m_mlp.outputSize() << ";\n";
+
+        for (int l = 0; l < numLayers; l++)
+        {
+            writeLayer(out, l);
+        }
+
+        out << "\n"
+            << "// Raw output-layer values of one sample of INPUT_SIZE values in [0, 1].\n"
+            << "inline void forwardRaw(const double *inputs, double *raw)\n"
+            << "{\n";
+        for (int l = 0; l < numLayers; l++)
+        {
+            LayerParameters layer = m_mlp.layer(l);
+            const std::string input = l == 0 ? "inputs" : "layer" + std::to_string(l);
+            const std::string output = l + 1 == numLayers ? "raw" : "layer" + std::to_string(l + 1);
+            const std::string n = std::to_string(l + 1);
+            if (l + 1 < numLayers)
+            {
+                out << "    alignas(64) double " << output << "[" << layer.outputs << "];\n";
+            }
+            out << "    for (int o = 0; o < " << layer.outputs << "; o++)\n"
+                << "    {\n"
+                << "        " << output << "[o] = LAYER" << n << "_BIASES[o];\n"
+                << "    }\n"
+                << "    for (int i = 0; i < " << layer.inputs << "; i++)\n"
+                << "    {\n"
+                << "        const double x = " << input << "[i];\n"
+                << "        for (int o = 0; o < " << layer.outputs << "; o++)\n"
+                << "        {\n"
+                << "            " << output << "[o] += LAYER" << n << "_WEIGHTS[i][o] * x;\n"
+                << "        }\n"
+                << "    }\n";
+            if (l + 1 < numLayers)
+            {
+                out << "    for (int o = 0; o < " << layer.outputs << "; o++)\n"
+                    << "    {\n"
+                    << "        " << output << "[o] = 1.0 / (1.0 + std::exp(-" << output << "[o]));\n"
+                    << "    }\n";
+            }
+        }
+        out << "}\n"
+            << "\n"
+            << "// Softmax probabilities of one sample.\n"
+            << "inline void forward(const double *inputs, double *probabilities)\n"
+            << "{\n"
+            << "    forwardRaw(inputs, probabilities);\n"
+            << "    double maxVal = probabilities[0];\n"
+            << "    for (int i = 1; i < OUTPUT_SIZE; i++)\n"
+            << "    {\n"
+            << "        maxVal = probabilities[i] > maxVal ? probabilities[i] : maxVal;\n"
+            << "    }\n"
+            << "    double sum = 0.0;\n"
+            << "    for (int i = 0; i < OUTPUT_SIZE; i++)\n"
+            << "    {\n"
+            << "        probabilities[i] = std::exp(probabilities[i] - maxVal);\n"
+            << "        sum += probabilities[i];\n"
+            << "    }\n"
+            << "    for (int i = 0; i < OUTPUT_SIZE; i++)\n"
+            << "    {\n"
+            << "        probabilities[i] /= sum;\n"
+            << "    }\n"
+            << "}\n"
+            << "\n"
+            << "// Predicted class; softmax keeps the order, so it is read off the raw outputs.\n"
+            << "inline int predict(const double *inputs)\n"
+            << "{\n"
+            << "    double raw[OUTPUT_SIZE];\n"
+            << "    forwardRaw(inputs, raw);\n"
+            << "    int best = 0;\n"
+            << "    for (int i = 1; i < OUTPUT_SIZE; i++)\n"
+            << "    {\n"
+            << "        best = raw[i] > raw[best] ? i : best;\n"
+            << "    }\n"
+            << "    return best;\n"
+            << "}\n"
+            << "\n"
+            << "} // namespace " << m_namespace << "\n";
+        return out.str();
+    }
+
+private:
+    const MLP &m_mlp;
+    std::string m_sourceName;
+    std::string m_namespace;
+
+    static bool isIdentifier(const std::string &name)
+    {
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+        {
+            return false;
+        }
+        for (char c : name)
+        {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string topology() const
+    {
+        std::string text = std::to_string(m_mlp.inputSize());
+        for (int l = 0; l < m_mlp.numLayers(); l++)
+        {
+            text += "-" + std::to_string(m_mlp.layer(l).outputs);
+        }
+        return text;
+    }
+
+    // Shortest of 15 to 17 significant digits that reads back exactly.
+    static std::string literal(double value)
+    {
+        if (!std::isfinite(value))
+        {
+            throw std::runtime_error("The model contains a non-finite parameter");
+        }
+        char text[32];
+        for (int digits = 15; digits <= 17; digits++)
+        {
+            std::snprintf(text, sizeof(text), "%.*g", digits, value);
+            if (std::strtod(text, nullptr) == value)
+            {
+                break;
+            }
+        }
+        std::string result = text;
+        if (result.find_first_of(".e") == std::string::npos)
+        {
+            result += ".0";
+        }
+        return result;
+    }
+
+    static void writeValues(std::ostringstream &out, const std::vector<double> &values, const char *indent)
+    {
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            if (i % VALUES_PER_LINE == 0)
+            {
+                out << indent;
+            }
+            out << literal(values[i]) << ",";
+            out << ((i + 1) % VALUES_PER_LINE == 0 || i + 1 == values.size() ? "\n" : " ");
+        }
+    }
+
+    void writeLayer(std::ostringstream &out, int index) const
+    {
+        LayerParameters layer = m_mlp.layer(index);
+        const std::string n = std::to_string(index + 1);
+        out << "\n"
+            << "// Layer " << n << ": " << layer.inputs << " -> " << layer.outputs
+            << (index + 1 == m_mlp.numLayers() ? ", output" : ", sigmoid") << "\n"
+            << "alignas(64) inline constexpr double LAYER" << n << "_WEIGHTS[" << layer.inputs << "]["
+            << layer.outputs << "] = {\n";
+        std::vector<double> row(layer.outputs);
+        for (int i = 0; i < layer.inputs; i++)
+        {
+            for (int o = 0; o < layer.outputs; o++)
+            {
+                row[o] = layer.weights[static_cast<size_t>(o) * layer.inputs + i];
+            }
+            out << "    {\n";
+            writeValues(out, row, "        ");
+            out << "    },\n";
+        }
+        out << "};\n"
+            << "alignas(64) inline constexpr double LAYER" << n << "_BIASES[" << layer.outputs << "] = {\n";
+        writeValues(out, std::vector<double>(layer.biases, layer.biases + layer.outputs), "    ");
+        out << "};\n";
+    }
+};
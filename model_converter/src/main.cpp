@@ -0,0 +1,550 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+
+#include "../../mlp/include/mlp.h"
+#include "../../mlp/include/quantized_mlp.h"
+#include "../../mlp/include/static_mlp.h"
+#include "header_exporter.hpp"
+
+//============================================================================
+// Parameters
+//============================================================================
+const std::string DEFAULT_TEST_FILE = "resources/training_data/mnist_test.csv";
+
+// Encodings in the order the report lists them.
+const ModelScalarType ENCODINGS[] = {MODEL_SCALAR_FLOAT64, MODEL_SCALAR_FLOAT32, MODEL_SCALAR_FLOAT16,
+                                     MODEL_SCALAR_BFLOAT16, MODEL_SCALAR_INT8};
+
+// Load timings in the report are the best of this many runs.
+const int LOAD_TIMING_RUNS = 20;
+
+// Throughput timings in the report are the best of this many passes over the test set.
+const int THROUGHPUT_RUNS = 5;
+
+// Namespace of the arrays and functions in generated headers.
+const std::string DEFAULT_HEADER_NAMESPACE = "mlp_model";
+
+// Production topology, compiled into the static network of the report.
+using ProductionMLP = StaticMLP<784, 128, 64, 10>;
+
+//============================================================================
+// Helper Functions
+//============================================================================
+
+void printUsage()
+{
+    std::cout << "Usage: model_converter <input model> <output model> [options]\n"
+              << "       model_converter --report <input model> [--test <csv>]\n"
+              << "       model_converter <input model> <output.h> --header [--namespace <name>]\n"
+              << "\n"
+              << "Converts a model file (legacy or current format) into the aligned\n"
+              << "model format and checks the converted model on the test set.\n"
+              << "--report converts to every encoding and compares size, load time\n"
+              << "and test accuracy, then does the same for the int8 inference engine.\n"
+              << "--header writes the model as a self-contained C++ header with constexpr\n"
+              << "weights and an inline forward pass, for builds without model files.\n"
+              << "\n"
+              << "Options:\n"
+              << "  --encoding <type>    float64 (default), float32, float16, bfloat16 or int8\n"
+              << "  --float32            same as --encoding float32\n"
+              << "  --test <csv>         test set to verify on (default: " << DEFAULT_TEST_FILE << ")\n"
+              << "  --tolerance <value>  largest output difference accepted for lossy encodings\n"
+              << "                       (default depends on the encoding)\n"
+              << "  --no-verify          skip the test set comparison\n"
+              << "  --namespace <name>   namespace of the generated header (default: "
+              << DEFAULT_HEADER_NAMESPACE << ")" << std::endl;
+}
+
+// Largest difference allowed between the softmax outputs of the original and
+// the converted model. float64 must reproduce the original exactly.
+double defaultTolerance(ModelScalarType scalarType)
+{
+    switch (scalarType)
+    {
+    case MODEL_SCALAR_FLOAT32:
+        return 1e-4;
+    case MODEL_SCALAR_FLOAT16:
+        return 1e-2;
+    case MODEL_SCALAR_BFLOAT16:
+        return 5e-2;
+    default:
+        return 1e-1;
+    }
+}
+
+ModelScalarType parseEncoding(const std::string &name)
+{
+    for (ModelScalarType scalarType : ENCODINGS)
+    {
+        if (name == modelScalarName(scalarType))
+        {
+            return scalarType;
+        }
+    }
+    throw std::invalid_argument("Unknown encoding: " + name);
+}
+
+bool isAlignedModelFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(MODEL_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, MODEL_MAGIC, sizeof(magic)) == 0;
+}
+
+int getPredictedClass(const std::vector<double> &output)
+{
+    return static_cast<int>(std::max_element(output.begin(), output.end()) - output.begin());
+}
+
+double accuracyPercent(int correct, int samples)
+{
+    return 100.0 * correct / std::max(samples, 1);
+}
+
+struct TestSet
+{
+    std::vector<unsigned char> pixels; // inputSize bytes per sample
+    std::vector<int> labels;
+};
+
+// Read an MNIST CSV file into memory as raw pixels.
+TestSet loadTestSet(const std::string &csvPath, int inputSize)
+{
+    std::ifstream file(csvPath);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open the CSV file: " + csvPath);
+    }
+
+    TestSet set;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line == "\r")
+        {
+            continue;
+        }
+
+        const char *p = line.c_str();
+        char *end;
+        set.labels.push_back(static_cast<int>(std::strtol(p, &end, 10)));
+        for (int i = 0; i < inputSize; i++)
+        {
+            if (*end != ',')
+            {
+                throw std::runtime_error("Invalid row format in CSV file: " + csvPath);
+            }
+            set.pixels.push_back(static_cast<unsigned char>(std::strtol(end + 1, &end, 10)));
+        }
+    }
+    return set;
+}
+
+//============================================================================
+// Verification
+//============================================================================
+
+struct Comparison
+{
+    int samples = 0;
+    int originalCorrect = 0;
+    int convertedCorrect = 0;
+    int predictionMismatches = 0;
+    int differingOutputs = 0;
+    double maxDifference = 0.0;
+};
+
+// Run both models on every row of an MNIST CSV file ("label,p0,...,pN").
+Comparison compareOnTestSet(MLP &original, MLP &converted, const std::string &csvPath)
+{
+    const int inputSize = original.inputSize();
+    TestSet test = loadTestSet(csvPath, inputSize);
+    std::vector<double> inputs(inputSize);
+    Comparison result;
+    for (size_t sample = 0; sample < test.labels.size(); sample++)
+    {
+        const int label = test.labels[sample];
+        Dataset::normalize(test.pixels.data() + sample * inputSize, inputSize, inputs.data());
+
+        std::vector<double> a = original.forward(inputs.data());
+        std::vector<double> b = converted.forward(inputs.data());
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i] != b[i])
+            {
+                result.differingOutputs++;
+                result.maxDifference = std::max(result.maxDifference, std::abs(a[i] - b[i]));
+            }
+        }
+        int predictedA = getPredictedClass(a);
+        int predictedB = getPredictedClass(b);
+        result.originalCorrect += predictedA == label;
+        result.convertedCorrect += predictedB == label;
+        result.predictionMismatches += predictedA != predictedB;
+        result.samples++;
+    }
+    return result;
+}
+
+// Write the model as a C++ header for builds that compile the weights in.
+int exportHeader(const std::string &inputPath, const std::string &outputPath,
+                 const std::string &namespaceName)
+{
+    MLP model = MLP::fromFile(inputPath);
+    HeaderExporter exporter(model, std::filesystem::path(inputPath).filename().string(), namespaceName);
+    exporter.write(outputPath);
+    std::cout << "Wrote " << outputPath << " (namespace " << namespaceName << ", "
+              << std::filesystem::file_size(outputPath) / 1024 << " KB)" << std::endl;
+    return 0;
+}
+
+//============================================================================
+// Commands
+//============================================================================
+
+int convert(const std::string &inputPath, const std::string &outputPath, ModelScalarType scalarType,
+            const std::string &testFile, double tolerance, bool verify)
+{
+    MLP original = MLP::fromFile(inputPath);
+    std::cout << "Loaded " << (isAlignedModelFile(inputPath) ? "aligned" : "legacy")
+              << " model: " << inputPath << " (" << original.inputSize() << " inputs, "
+              << original.outputSize() << " outputs)" << std::endl;
+
+    original.saveModel(outputPath, scalarType);
+    std::cout << "Wrote " << modelScalarName(scalarType) << " model: " << outputPath << " ("
+              << std::filesystem::file_size(outputPath) / 1024 << " KB)" << std::endl;
+
+    if (!verify)
+    {
+        return 0;
+    }
+
+    MLP converted = MLP::fromFile(outputPath);
+    if (converted.inputSize() != original.inputSize() || converted.outputSize() != original.outputSize())
+    {
+        throw std::runtime_error("Converted model has a different topology.");
+    }
+
+    Comparison result = compareOnTestSet(original, converted, testFile);
+    double originalAccuracy = accuracyPercent(result.originalCorrect, result.samples);
+    double convertedAccuracy = accuracyPercent(result.convertedCorrect, result.samples);
+    std::cout << "\n----- Verification on " << result.samples << " test samples -----" << std::endl;
+    std::cout << "Original accuracy:     " << originalAccuracy << "%" << std::endl;
+    std::cout << "Converted accuracy:    " << convertedAccuracy << "%" << std::endl;
+    std::cout << "Accuracy delta:        " << std::showpos << convertedAccuracy - originalAccuracy
+              << std::noshowpos << " percentage points" << std::endl;
+    std::cout << "Changed predictions:   " << result.predictionMismatches << std::endl;
+    std::cout << "Max output difference: " << result.maxDifference << std::endl;
+
+    // float64 conversion must reproduce the original bit for bit.
+    bool passed = scalarType == MODEL_SCALAR_FLOAT64
+                      ? result.differingOutputs == 0
+                      : result.maxDifference <= tolerance;
+    if (!passed)
+    {
+        std::cerr << "Verification FAILED: outputs differ beyond the allowed tolerance of "
+                  << tolerance << "." << std::endl;
+        return 1;
+    }
+    std::cout << (scalarType == MODEL_SCALAR_FLOAT64 ? "Verification passed: outputs are bit-identical."
+                                                     : "Verification passed: outputs are within tolerance.")
+              << std::endl;
+    return 0;
+}
+
+// Time MLP::fromFile on a file, best of LOAD_TIMING_RUNS.
+double bestLoadMilliseconds(const std::string &path)
+{
+    double best = 0.0;
+    for (int run = 0; run < LOAD_TIMING_RUNS; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        MLP model = MLP::fromFile(path);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = run == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+// Best images per second of run() over THROUGHPUT_RUNS passes of `count` images.
+template <typename Run>
+double bestThroughput(size_t count, Run run)
+{
+    double best = 0.0;
+    for (int pass = 0; pass < THROUGHPUT_RUNS; pass++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, count / seconds);
+    }
+    return best;
+}
+
+// Compare the int8 inference engine with the original model: accuracy,
+// changed predictions, output difference, speed and memory.
+void reportQuantizedEngine(const MLP &original, const std::string &testFile)
+{
+    QuantizedMLP quantized(original);
+    TestSet test = loadTestSet(testFile, original.inputSize());
+    const size_t count = test.labels.size();
+    const int n = original.outputSize();
+
+    std::vector<double> inputs(test.pixels.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        Dataset::normalize(test.pixels.data() + i * original.inputSize(), original.inputSize(),
+                           inputs.data() + i * original.inputSize());
+    }
+    std::vector<double> expected(count * n);
+    std::vector<double> actual(count * n);
+    std::vector<int> originalClasses(count);
+    std::vector<int> quantizedClasses(count);
+    original.forwardBatch(inputs.data(), count, expected.data());
+    quantized.forwardBatch(test.pixels.data(), count, actual.data());
+
+    int originalCorrect = 0;
+    int quantizedCorrect = 0;
+    int changed = 0;
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const double *a = expected.data() + i * n;
+        const double *b = actual.data() + i * n;
+        originalClasses[i] = static_cast<int>(std::max_element(a, a + n) - a);
+        quantizedClasses[i] = static_cast<int>(std::max_element(b, b + n) - b);
+        originalCorrect += originalClasses[i] == test.labels[i];
+        quantizedCorrect += quantizedClasses[i] == test.labels[i];
+        changed += originalClasses[i] != quantizedClasses[i];
+        for (int k = 0; k < n; k++)
+        {
+            maxDifference = std::max(maxDifference, std::abs(expected[i * n + k] - actual[i * n + k]));
+        }
+    }
+
+    // Throughput as a caller sees it: forwardBatch from raw pixels includes
+    // the conversion to double, the int8 engine reads the pixels directly.
+    double originalRate = bestThroughput(count, [&]
+                                         {
+        for (size_t i = 0; i < count; i++)
+        {
+            Dataset::normalize(test.pixels.data() + i * original.inputSize(), original.inputSize(),
+                               inputs.data() + i * original.inputSize());
+        }
+        original.forwardBatch(inputs.data(), count, originalClasses.data()); });
+    double quantizedRate = bestThroughput(count, [&]
+                                          { quantized.forwardBatch(test.pixels.data(), count, quantizedClasses.data()); });
+
+    size_t originalBytes = 0;
+    for (int l = 0; l < original.numLayers(); l++)
+    {
+        LayerParameters layer = original.layer(l);
+        originalBytes += (static_cast<size_t>(layer.inputs) + 1) * layer.outputs * sizeof(double);
+    }
+
+    double originalAccuracy = accuracyPercent(originalCorrect, static_cast<int>(count));
+    double quantizedAccuracy = accuracyPercent(quantizedCorrect, static_cast<int>(count));
+    std::cout << "\n----- int8 inference engine (" << QuantizedMLP::kernelName() << " kernel), "
+              << count << " test samples -----" << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+              << "Accuracy:              " << quantizedAccuracy << "% (float64 " << originalAccuracy << "%, "
+              << std::showpos << quantizedAccuracy - originalAccuracy << std::noshowpos << " pp)" << std::endl;
+    std::cout << "Changed predictions:   " << changed << std::endl;
+    std::cout << "Max output difference: " << std::scientific << std::setprecision(1) << maxDifference << std::endl;
+    std::cout << std::fixed << std::setprecision(0)
+              << "Throughput:            " << quantizedRate << " images/s (float64 forwardBatch "
+              << originalRate << " images/s, " << std::setprecision(1) << quantizedRate / originalRate << "x)" << std::endl;
+    std::cout << "Parameters in memory:  " << quantized.parameterBytes() / 1024 << " KB (float64 "
+              << originalBytes / 1024 << " KB)" << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+// Compare the compile-time specialized network with MLP on single samples:
+// identical outputs and latency. Only models of the production topology.
+void reportStaticNetwork(const MLP &original, const std::string &testFile)
+{
+    std::vector<int> sizes = {original.inputSize()};
+    for (int l = 0; l < original.numLayers(); l++)
+    {
+        sizes.push_back(original.layer(l).outputs);
+    }
+    if (sizes != std::vector<int>{784, 128, 64, 10})
+    {
+        std::cout << "\n(StaticMLP section skipped: the model is not 784-128-64-10)" << std::endl;
+        return;
+    }
+
+    ProductionMLP network(original);
+    TestSet test = loadTestSet(testFile, original.inputSize());
+    const size_t count = test.labels.size();
+    const int n = original.outputSize();
+
+    std::vector<double> inputs(test.pixels.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        Dataset::normalize(test.pixels.data() + i * original.inputSize(), original.inputSize(),
+                           inputs.data() + i * original.inputSize());
+    }
+    std::vector<double> expected(count * n);
+    std::vector<double> actual(count * n);
+    original.forwardBatch(inputs.data(), count, expected.data());
+    network.forwardBatch(inputs.data(), count, actual.data());
+    size_t differing = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        differing += std::memcmp(expected.data() + i * n, actual.data() + i * n, n * sizeof(double)) != 0;
+    }
+
+    // One sample per call, as an interactive caller would.
+    InferenceContext context;
+    double dynamicRate = bestThroughput(count, [&]
+                                        {
+        for (size_t i = 0; i < count; i++)
+        {
+            original.forward(inputs.data() + i * original.inputSize(), context);
+        } });
+    double staticRate = bestThroughput(count, [&]
+                                       {
+        for (size_t i = 0; i < count; i++)
+        {
+            network.forward(inputs.data() + i * original.inputSize(), actual.data() + i * n);
+        } });
+
+    std::cout << "\n----- StaticMLP<784, 128, 64, 10>, " << count << " test samples -----" << std::endl;
+    std::cout << "Samples with different outputs: " << differing << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+              << "Latency per sample:             " << 1e6 / staticRate << " us (MLP::forward "
+              << 1e6 / dynamicRate << " us, " << std::setprecision(1) << staticRate / dynamicRate << "x)"
+              << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+int report(const std::string &inputPath, const std::string &testFile)
+{
+    MLP original = MLP::fromFile(inputPath);
+    std::cout << "Model: " << inputPath << " (" << original.inputSize() << " inputs, "
+              << original.outputSize() << " outputs)" << std::endl;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::uintmax_t referenceSize = 0;
+    std::cout << "\nEncoding   Size (KB)  Ratio  Load (ms)  Accuracy  Delta (pp)  Changed  Max diff" << std::endl;
+    std::cout << "--------------------------------------------------------------------------------" << std::endl;
+    for (ModelScalarType scalarType : ENCODINGS)
+    {
+        std::string path = (directory / (std::string("model_converter_report.") + modelScalarName(scalarType))).string();
+        original.saveModel(path, scalarType);
+        std::uintmax_t size = std::filesystem::file_size(path);
+        if (scalarType == MODEL_SCALAR_FLOAT64)
+        {
+            referenceSize = size;
+        }
+        double loadMs = bestLoadMilliseconds(path);
+
+        MLP converted = MLP::fromFile(path);
+        Comparison result = compareOnTestSet(original, converted, testFile);
+        double delta = accuracyPercent(result.convertedCorrect, result.samples) -
+                       accuracyPercent(result.originalCorrect, result.samples);
+        std::cout << std::left << std::setw(9) << modelScalarName(scalarType) << std::right
+                  << std::setw(11) << size / 1024
+                  << std::setw(6) << std::fixed << std::setprecision(1) << static_cast<double>(referenceSize) / size << "x"
+                  << std::setw(11) << std::setprecision(3) << loadMs
+                  << std::setw(9) << std::setprecision(2) << accuracyPercent(result.convertedCorrect, result.samples) << "%"
+                  << std::setw(12) << std::showpos << delta << std::noshowpos
+                  << std::setw(9) << result.predictionMismatches
+                  << std::setw(10) << std::scientific << std::setprecision(1) << result.maxDifference
+                  << std::defaultfloat << std::setprecision(6) << std::endl;
+        std::filesystem::remove(path);
+    }
+
+    reportQuantizedEngine(original, testFile);
+    reportStaticNetwork(original, testFile);
+    return 0;
+}
+
+//============================================================================
+// Main Entry
+//============================================================================
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return 1;
+    }
+
+    try
+    {
+        bool reportMode = std::string(argv[1]) == "--report";
+        std::string inputPath = reportMode ? argv[2] : argv[1];
+        std::string outputPath = reportMode ? "" : argv[2];
+        ModelScalarType scalarType = MODEL_SCALAR_FLOAT64;
+        std::string testFile = DEFAULT_TEST_FILE;
+        double tolerance = -1.0;
+        bool verify = true;
+        bool header = false;
+        std::string namespaceName = DEFAULT_HEADER_NAMESPACE;
+
+        for (int i = 3; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--encoding" && i + 1 < argc)
+            {
+                scalarType = parseEncoding(argv[++i]);
+            }
+            else if (arg == "--float32")
+            {
+                scalarType = MODEL_SCALAR_FLOAT32;
+            }
+            else if (arg == "--test" && i + 1 < argc)
+            {
+                testFile = argv[++i];
+            }
+            else if (arg == "--tolerance" && i + 1 < argc)
+            {
+                tolerance = std::stod(argv[++i]);
+            }
+            else if (arg == "--no-verify")
+            {
+                verify = false;
+            }
+            else if (arg == "--header")
+            {
+                header = true;
+            }
+            else if (arg == "--namespace" && i + 1 < argc)
+            {
+                namespaceName = argv[++i];
+            }
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+
+        if (reportMode)
+        {
+            return report(inputPath, testFile);
+        }
+        if (header)
+        {
+            return exportHeader(inputPath, outputPath, namespaceName);
+        }
+        return convert(inputPath, outputPath, scalarType, testFile,
+                       tolerance >= 0.0 ? tolerance : defaultTolerance(scalarType), verify);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
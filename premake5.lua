@@ -96,3 +96,88 @@ project "draw_and_predict"
          "{COPY} vendor/opencv/build/x64/vc16/bin/opencv_world4110.dll %{cfg.targetdir}",
       }
 
+
+project "model_converter"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   staticruntime "off"
+   targetdir "bin/%{cfg.platform}/%{cfg.buildcfg}/model_converter"
+   objdir "obj/%{cfg.platform}/%{cfg.buildcfg}/model_converter"
+   files { "model_converter/src/**.hpp", "model_converter/src/**.cpp" }
+   includedirs { "mlp/include", "model_converter/src" }
+   libdirs { "bin/%{cfg.platform}/%{cfg.buildcfg}/mlp" }
+   links { "mlp" }
+   debugdir "%{cfg.targetdir}"
+   postbuildcommands {
+      "{COPY} bin/%{cfg.platform}/%{cfg.buildcfg}/mlp/mlp.dll %{cfg.targetdir}",
+      "{COPY} MNIST/resources %{cfg.targetdir}/resources",
+      "{COPY} MNIST/models %{cfg.targetdir}/models",
+   }
+   filter "system:windows"
+      systemversion "latest"
+      defines { "PLATFORM_WINDOWS" }
+   filter "configurations:Debug"
+      defines "DEBUG"
+      runtime "Debug"
+      symbols "on"
+   filter "configurations:Release"
+      defines "NDEBUG"
+      runtime "Release"
+      optimize "on"
+
+project "inference_server"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   staticruntime "off"
+   targetdir "bin/%{cfg.platform}/%{cfg.buildcfg}/inference_server"
+   objdir "obj/%{cfg.platform}/%{cfg.buildcfg}/inference_server"
+   files { "inference_server/src/**.hpp", "inference_server/src/**.cpp" }
+   includedirs { "mlp/include", "inference_server/src" }
+   libdirs { "bin/%{cfg.platform}/%{cfg.buildcfg}/mlp" }
+   links { "mlp" }
+   debugdir "%{cfg.targetdir}"
+   postbuildcommands {
+      "{COPY} bin/%{cfg.platform}/%{cfg.buildcfg}/mlp/mlp.dll %{cfg.targetdir}",
+      "{COPY} MNIST/models %{cfg.targetdir}/models",
+   }
+   filter "system:windows"
+      systemversion "latest"
+      defines { "PLATFORM_WINDOWS" }
+      links { "Ws2_32" }
+   filter "configurations:Debug"
+      defines "DEBUG"
+      runtime "Debug"
+      symbols "on"
+   filter "configurations:Release"
+      defines "NDEBUG"
+      runtime "Release"
+      optimize "on"
+
+project "load_generator"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   staticruntime "off"
+   targetdir "bin/%{cfg.platform}/%{cfg.buildcfg}/load_generator"
+   objdir "obj/%{cfg.platform}/%{cfg.buildcfg}/load_generator"
+   files { "load_generator/src/**.hpp", "load_generator/src/**.cpp" }
+   -- Shares the socket and wire-format headers of the server.
+   includedirs { "load_generator/src", "inference_server/src" }
+   debugdir "%{cfg.targetdir}"
+   postbuildcommands {
+      "{COPY} MNIST/resources %{cfg.targetdir}/resources",
+   }
+   filter "system:windows"
+      systemversion "latest"
+      defines { "PLATFORM_WINDOWS" }
+      links { "Ws2_32" }
+   filter "configurations:Debug"
+      defines "DEBUG"
+      runtime "Debug"
+      symbols "on"
+   filter "configurations:Release"
+      defines "NDEBUG"
+      runtime "Release"
+      optimize "on"